@@ -71,6 +71,16 @@ static const unsigned int DT_OFFMESH_CON_BIDIR = 1;
 /// @ingroup detour
 static const int DT_MAX_AREAS = 64;
 
+/// The maximum number of polygon grid cells a tile query will visit before 
+/// falling back to the tile's bounding volume tree.
+/// @ingroup detour
+static const int DT_POLYGRID_MAX_QUERY_CELLS = 16;
+
+/// The maximum number of polygons a tile query will gather from the polygon grid
+/// before falling back to the tile's bounding volume tree.
+/// @ingroup detour
+static const int DT_POLYGRID_MAX_QUERY_POLYS = 256;
+
 /// Tile flags used for various functions and fields.
 /// For an example, see dtNavMesh::addTile().
 enum dtTileFlags
@@ -191,6 +201,17 @@ struct dtOffMeshConnection
 	unsigned int userId;
 };
 
+/// Describes an optional grid over the xz-plane footprint of a tile, listing
+/// the polygons which overlap each cell.
+/// @ingroup detour
+struct dtPolyGrid
+{
+	int width;			///< The number of cells along the x-axis.
+	int height;			///< The number of cells along the z-axis.
+	int polyCount;		///< The number of entries in the grid's polygon list.
+	float cellSize;		///< The width and depth of each cell. [Unit: wu]
+};
+
 /// Provides high level information related to a dtMeshTile object.
 /// @ingroup detour
 struct dtMeshHeader
@@ -247,6 +268,15 @@ struct dtMeshTile
 	dtBVNode* bvTree;
 
 	dtOffMeshConnection* offMeshCons;		///< The tile off-mesh connections. [Size: dtMeshHeader::offMeshConCount]
+
+	/// The tile polygon grid. (Will be null if the grid was not built.)
+	dtPolyGrid* polyGrid;
+
+	/// The index of each cell's first entry in #polyGridPolys. [Size: width * height + 1]
+	int* polyGridCells;
+
+	/// The polygon indices overlapping each cell. [Size: dtPolyGrid::polyCount]
+	unsigned short* polyGridPolys;
 		
 	unsigned char* data;					///< The tile data. (Not directly accessed under normal situations.)
 	int dataSize;							///< Size of the tile data.
@@ -254,6 +284,34 @@ struct dtMeshTile
 	dtMeshTile* next;						///< The next free tile, or the next tile in the spatial grid.
 };
 
+/// Finds the polygon grid cell containing the specified position, clamped to the grid.
+///  @param[in]		grid	The polygon grid.
+///  @param[in]		orig	The minimum bounds of the grid's tile. [(x, y, z)]
+///  @param[in]		pos		The position to locate. [(x, y, z)]
+///  @param[out]	x		The cell's x-index.
+///  @param[out]	z		The cell's z-index.
+/// @ingroup detour
+void dtPolyGridCellAt(const dtPolyGrid* grid, const float* orig, const float* pos, int* x, int* z);
+
+/// Derives the size of a polygon grid, including its header, in tile data.
+///  @param[in]		grid	The polygon grid.
+/// @return The size of the grid data. [Unit: bytes]
+/// @ingroup detour
+int dtPolyGridDataSize(const dtPolyGrid* grid);
+
+/// Finds the ground polygons in a tile whose bounds overlap the specified box, using
+/// the tile's polygon grid.
+///  @param[in]		tile		The tile to query.
+///  @param[in]		qmin		The minimum bounds of the query box. [(x, y, z)]
+///  @param[in]		qmax		The maximum bounds of the query box. [(x, y, z)]
+///  @param[out]	polys		The indices of the polygons within the tile.
+///  @param[in]		maxPolys	The maximum number of polygons to return.
+/// @return The number of polygons found, or -1 if the tile has no grid, the box
+/// 	covers too many cells, or there were more than @p maxPolys polygons.
+/// @ingroup detour
+int dtQueryPolyGrid(const dtMeshTile* tile, const float* qmin, const float* qmax,
+					unsigned short* polys, const int maxPolys);
+
 /// Configuration parameters used to define multi-tile navigation meshes.
 /// The values are used to allocate space during the initialization of a navigation mesh.
 /// @see dtNavMesh::init()
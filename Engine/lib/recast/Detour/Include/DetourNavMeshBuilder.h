@@ -101,6 +101,10 @@ struct dtNavMeshCreateParams
 	/// @note The BVTree is not normally needed for layered navigation meshes.
 	bool buildBvTree;
 
+	/// The cell size of the tile's polygon grid, or zero to not build one. [Unit: wu]
+	/// @note The grid speeds up small queries, such as finding the nearest polygon.
+	float polyGridCellSize;
+
 	/// @}
 };
 
@@ -115,6 +115,25 @@ public:
 
 };
 
+/// Estimates the cost of travelling between two polygons, to guide A*
+/// searches better than the straight-line distance does on its own.
+/// @ingroup detour
+class dtQueryHeuristic
+{
+public:
+	virtual ~dtQueryHeuristic() {}
+
+	/// Returns an estimate of the cost of travelling from one point to another.
+	/// Estimates that never exceed the true cost keep paths as short as
+	/// the straight-line heuristic does.
+	///  @param[in]		fromRef		The reference id of the polygon containing the start point.
+	///  @param[in]		fromPos		The start point. [(x, y, z)]
+	///  @param[in]		toRef		The reference id of the polygon containing the end point.
+	///  @param[in]		toPos		The end point. [(x, y, z)]
+	virtual float getCost(const dtPolyRef fromRef, const float* fromPos,
+						  const dtPolyRef toRef, const float* toPos) const = 0;
+};
+
 /// Provides the ability to perform pathfinding related queries against
 /// a navigation mesh.
 /// @ingroup detour
@@ -209,6 +228,16 @@ public:
 	dtStatus finalizeSlicedFindPathPartial(const dtPolyRef* existing, const int existingSize,
 										   dtPolyRef* path, int* pathCount, const int maxPath);
 
+	/// Returns the path found so far by an in-progress sliced path query, from the start polygon
+	/// to the visited polygon nearest the end position. Unlike finalizeSlicedFindPathPartial(),
+	/// the query can be updated afterwards.
+	///  @param[out]	path		An ordered list of polygon references representing the path. (Start to end.) 
+	///  							[(polyRef) * @p pathCount]
+	///  @param[out]	pathCount	The number of polygons returned in the @p path array.
+	///  @param[in]		maxPath		The max number of polygons the @p path array can hold. [Limit: >= 1]
+	/// @returns The status flags for the query.
+	dtStatus getSlicedFindPathPartial(dtPolyRef* path, int* pathCount, const int maxPath) const;
+
 	///@}
 	/// @name Dijkstra Search Functions
 	/// @{ 
@@ -417,6 +446,16 @@ public:
 	/// @return The navigation mesh the query object is using.
 	const dtNavMesh* getAttachedNavMesh() const { return m_nav; }
 
+	/// Sets an extra heuristic for findPath and sliced path queries to use.
+	/// The larger of it and the straight-line distance is used.
+	///  @param[in]		heuristic	The heuristic to use, or null for none. It must
+	///								stay valid while it is set.
+	void setHeuristic(const dtQueryHeuristic* heuristic) { m_heuristic = heuristic; }
+
+	/// Gets the extra heuristic used by path queries.
+	/// @return The heuristic, or null if only straight-line distance is used.
+	const dtQueryHeuristic* getHeuristic() const { return m_heuristic; }
+
 	/// @}
 	
 private:
@@ -446,7 +485,12 @@ private:
 							 dtPolyRef to, const dtPoly* toPoly, const dtMeshTile* toTile,
 							 float* mid) const;
 	
+	/// Returns the A* heuristic from a point to the end of a path.
+	float getHeuristicCost(const dtPolyRef ref, const float* pos,
+						   const dtPolyRef endRef, const float* endPos) const;
+	
 	const dtNavMesh* m_nav;				///< Pointer to navmesh data.
+	const dtQueryHeuristic* m_heuristic;	///< Extra search heuristic. [opt]
 
 	struct dtQueryData
 	{
@@ -675,9 +675,87 @@ dtPolyRef dtNavMesh::findNearestPolyInTile(const dtMeshTile* tile,
 	return nearest;
 }
 
+void dtPolyGridCellAt(const dtPolyGrid* grid, const float* orig, const float* pos, int* x, int* z)
+{
+	*x = dtClamp((int)floorf((pos[0]-orig[0]) / grid->cellSize), 0, grid->width-1);
+	*z = dtClamp((int)floorf((pos[2]-orig[2]) / grid->cellSize), 0, grid->height-1);
+}
+
+int dtPolyGridDataSize(const dtPolyGrid* grid)
+{
+	return dtAlign4(sizeof(dtPolyGrid)) +
+		   dtAlign4(sizeof(int)*(grid->width*grid->height+1)) +
+		   dtAlign4(sizeof(unsigned short)*grid->polyCount);
+}
+
+int dtQueryPolyGrid(const dtMeshTile* tile, const float* qmin, const float* qmax,
+					unsigned short* polys, const int maxPolys)
+{
+	const dtPolyGrid* grid = tile->polyGrid;
+	if (!grid)
+		return -1;
+	const float* orig = tile->header->bmin;
+	
+	int minx, minz, maxx, maxz;
+	dtPolyGridCellAt(grid, orig, qmin, &minx, &minz);
+	dtPolyGridCellAt(grid, orig, qmax, &maxx, &maxz);
+	if ((maxx-minx+1) * (maxz-minz+1) > DT_POLYGRID_MAX_QUERY_CELLS)
+		return -1;
+	
+	int n = 0;
+	for (int z = minz; z <= maxz; ++z)
+	{
+		for (int x = minx; x <= maxx; ++x)
+		{
+			const int cell = x + z*grid->width;
+			for (int k = tile->polyGridCells[cell]; k < tile->polyGridCells[cell+1]; ++k)
+			{
+				const unsigned short i = tile->polyGridPolys[k];
+				const dtPoly* p = &tile->polys[i];
+				// Calc polygon bounds.
+				float bmin[3], bmax[3];
+				const float* v = &tile->verts[p->verts[0]*3];
+				dtVcopy(bmin, v);
+				dtVcopy(bmax, v);
+				for (int j = 1; j < p->vertCount; ++j)
+				{
+					v = &tile->verts[p->verts[j]*3];
+					dtVmin(bmin, v);
+					dtVmax(bmax, v);
+				}
+				if (!dtOverlapBounds(qmin,qmax, bmin,bmax))
+					continue;
+				// Polygons are listed in every cell they touch, so only take each
+				// one from the first of those cells covered by the query.
+				int px, pz;
+				dtPolyGridCellAt(grid, orig, bmin, &px, &pz);
+				if (dtMax(px, minx) != x || dtMax(pz, minz) != z)
+					continue;
+				if (n >= maxPolys)
+					return -1;
+				polys[n++] = i;
+			}
+		}
+	}
+	
+	return n;
+}
+
 int dtNavMesh::queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, const float* qmax,
 								   dtPolyRef* polys, const int maxPolys) const
 {
+	// Small queries are quicker to answer from the polygon grid.
+	unsigned short gridPolys[DT_POLYGRID_MAX_QUERY_POLYS];
+	const int gridPolyCount = dtQueryPolyGrid(tile, qmin, qmax, gridPolys, DT_POLYGRID_MAX_QUERY_POLYS);
+	if (gridPolyCount >= 0)
+	{
+		dtPolyRef base = getPolyRefBase(tile);
+		int n = 0;
+		for (int i = 0; i < gridPolyCount && n < maxPolys; ++i)
+			polys[n++] = base | (dtPolyRef)gridPolys[i];
+		return n;
+	}
+
 	if (tile->bvTree)
 	{
 		const dtBVNode* node = &tile->bvTree[0];
@@ -857,6 +935,23 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 	if (!bvtreeSize)
 		tile->bvTree = 0;
 
+	// The polygon grid is optional, and stored in any data left over.
+	tile->polyGrid = 0;
+	tile->polyGridCells = 0;
+	tile->polyGridPolys = 0;
+	const int polyGridHeaderSize = dtAlign4(sizeof(dtPolyGrid));
+	if (d + polyGridHeaderSize <= data + dataSize)
+	{
+		dtPolyGrid* grid = (dtPolyGrid*)d;
+		if (grid->width > 0 && grid->height > 0 && d + dtPolyGridDataSize(grid) <= data + dataSize)
+		{
+			tile->polyGrid = grid;
+			tile->polyGridCells = (int*)(d + polyGridHeaderSize);
+			tile->polyGridPolys = (unsigned short*)(d + polyGridHeaderSize +
+													dtAlign4(sizeof(int)*(grid->width*grid->height+1)));
+		}
+	}
+
 	// Build links freelist
 	tile->linksFreeList = 0;
 	tile->links[header->maxLinkCount-1].next = DT_NULL_LINK;
@@ -1171,6 +1266,9 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 	tile->detailTris = 0;
 	tile->bvTree = 0;
 	tile->offMeshCons = 0;
+	tile->polyGrid = 0;
+	tile->polyGridCells = 0;
+	tile->polyGridPolys = 0;
 
 	// Update salt, salt should never be zero.
 	tile->salt = (tile->salt+1) & ((1<<m_saltBits)-1);
@@ -244,6 +244,35 @@ static unsigned char classifyOffMeshPoint(const float* pt, const float* bmin, co
 
 // TODO: Better error handling.
 
+static void calcPolyGridRange(const dtNavMeshCreateParams* params, const dtPolyGrid* grid,
+							  const unsigned short* p, int* minx, int* minz, int* maxx, int* maxz)
+{
+	// Use the same vertex positions as the stored tile, so queries agree
+	// with the cells we list each polygon in.
+	float bmin[3], bmax[3];
+	for (int j = 0; j < params->nvp; ++j)
+	{
+		if (p[j] == MESH_NULL_IDX) break;
+		const unsigned short* iv = &params->verts[p[j]*3];
+		float v[3];
+		v[0] = params->bmin[0] + iv[0] * params->cs;
+		v[1] = params->bmin[1] + iv[1] * params->ch;
+		v[2] = params->bmin[2] + iv[2] * params->cs;
+		if (j == 0)
+		{
+			dtVcopy(bmin, v);
+			dtVcopy(bmax, v);
+		}
+		else
+		{
+			dtVmin(bmin, v);
+			dtVmax(bmax, v);
+		}
+	}
+	dtPolyGridCellAt(grid, params->bmin, bmin, minx, minz);
+	dtPolyGridCellAt(grid, params->bmin, bmax, maxx, maxz);
+}
+
 /// @par
 /// 
 /// The output data array is allocated using the detour allocator (dtAlloc()).  The method
@@ -397,6 +426,23 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 		}
 	}
 	
+	// Size the polygon grid. Polygon indices are stored as 16 bits.
+	dtPolyGrid polyGrid;
+	memset(&polyGrid, 0, sizeof(polyGrid));
+	const bool buildPolyGrid = params->polyGridCellSize > 0 && params->polyCount <= 0xffff;
+	if (buildPolyGrid)
+	{
+		polyGrid.cellSize = params->polyGridCellSize;
+		polyGrid.width = dtMax(1, (int)ceilf((params->bmax[0] - params->bmin[0]) / polyGrid.cellSize));
+		polyGrid.height = dtMax(1, (int)ceilf((params->bmax[2] - params->bmin[2]) / polyGrid.cellSize));
+		for (int i = 0; i < params->polyCount; ++i)
+		{
+			int minx, minz, maxx, maxz;
+			calcPolyGridRange(params, &polyGrid, &params->polys[i*nvp*2], &minx, &minz, &maxx, &maxz);
+			polyGrid.polyCount += (maxx-minx+1) * (maxz-minz+1);
+		}
+	}
+	
 	// Calculate data size
 	const int headerSize = dtAlign4(sizeof(dtMeshHeader));
 	const int vertsSize = dtAlign4(sizeof(float)*3*totVertCount);
@@ -407,10 +453,11 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*detailTriCount);
 	const int bvTreeSize = params->buildBvTree ? dtAlign4(sizeof(dtBVNode)*params->polyCount*2) : 0;
 	const int offMeshConsSize = dtAlign4(sizeof(dtOffMeshConnection)*storedOffMeshConCount);
+	const int polyGridSize = buildPolyGrid ? dtPolyGridDataSize(&polyGrid) : 0;
 	
 	const int dataSize = headerSize + vertsSize + polysSize + linksSize +
 						 detailMeshesSize + detailVertsSize + detailTrisSize +
-						 bvTreeSize + offMeshConsSize;
+						 bvTreeSize + offMeshConsSize + polyGridSize;
 						 
 	unsigned char* data = (unsigned char*)dtAlloc(sizeof(unsigned char)*dataSize, DT_ALLOC_PERM);
 	if (!data)
@@ -430,6 +477,7 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 	unsigned char* navDTris = (unsigned char*)d; d += detailTrisSize;
 	dtBVNode* navBvtree = (dtBVNode*)d; d += bvTreeSize;
 	dtOffMeshConnection* offMeshCons = (dtOffMeshConnection*)d; d += offMeshConsSize;
+	unsigned char* navPolyGrid = d; d += polyGridSize;
 	
 	
 	// Store header
@@ -623,6 +671,42 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 			n++;
 		}
 	}
+	
+	// Store polygon grid.
+	if (buildPolyGrid)
+	{
+		const int cellCount = polyGrid.width * polyGrid.height;
+		memcpy(navPolyGrid, &polyGrid, sizeof(dtPolyGrid));
+		int* cells = (int*)(navPolyGrid + dtAlign4(sizeof(dtPolyGrid)));
+		unsigned short* gridPolys = (unsigned short*)((unsigned char*)cells + dtAlign4(sizeof(int)*(cellCount+1)));
+		
+		// Count the polygons in each cell, then turn the counts into start indices.
+		for (int i = 0; i < params->polyCount; ++i)
+		{
+			int minx, minz, maxx, maxz;
+			calcPolyGridRange(params, &polyGrid, &params->polys[i*nvp*2], &minx, &minz, &maxx, &maxz);
+			for (int z = minz; z <= maxz; ++z)
+				for (int x = minx; x <= maxx; ++x)
+					cells[x + z*polyGrid.width + 1]++;
+		}
+		for (int i = 0; i < cellCount; ++i)
+			cells[i+1] += cells[i];
+		
+		// Fill the cells, using each start index as a cursor.
+		for (int i = 0; i < params->polyCount; ++i)
+		{
+			int minx, minz, maxx, maxz;
+			calcPolyGridRange(params, &polyGrid, &params->polys[i*nvp*2], &minx, &minz, &maxx, &maxz);
+			for (int z = minz; z <= maxz; ++z)
+				for (int x = minx; x <= maxx; ++x)
+					gridPolys[cells[x + z*polyGrid.width]++] = (unsigned short)i;
+		}
+		
+		// Each cursor now points at the start of the next cell.
+		for (int i = cellCount; i > 0; --i)
+			cells[i] = cells[i-1];
+		cells[0] = 0;
+	}
 		
 	dtFree(offMeshConClass);
 	
@@ -632,6 +716,15 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 	return true;
 }
 
+static bool isPolyGridSize(const dtPolyGrid* grid, const int size)
+{
+	if (grid->width <= 0 || grid->height <= 0 || grid->polyCount < 0)
+		return false;
+	if (grid->width > 0xffff || grid->height > 0xffff || grid->width*grid->height > 0xffffff)
+		return false;
+	return dtPolyGridDataSize(grid) == size;
+}
+
 bool dtNavMeshHeaderSwapEndian(unsigned char* data, const int /*dataSize*/)
 {
 	dtMeshHeader* header = (dtMeshHeader*)data;
@@ -684,7 +777,7 @@ bool dtNavMeshHeaderSwapEndian(unsigned char* data, const int /*dataSize*/)
 /// Call #dtNavMeshHeaderSwapEndian() first on the data if the data is expected to be in wrong endianess 
 /// to start with. Call #dtNavMeshHeaderSwapEndian() after the data has been swapped if converting from 
 /// native to foreign endianess.
-bool dtNavMeshDataSwapEndian(unsigned char* data, const int /*dataSize*/)
+bool dtNavMeshDataSwapEndian(unsigned char* data, const int dataSize)
 {
 	// Make sure the data is in right format.
 	dtMeshHeader* header = (dtMeshHeader*)data;
@@ -771,5 +864,39 @@ bool dtNavMeshDataSwapEndian(unsigned char* data, const int /*dataSize*/)
 		dtSwapEndian(&con->poly);
 	}
 	
+	// Polygon grid, if there is one.
+	const int polyGridHeaderSize = dtAlign4(sizeof(dtPolyGrid));
+	if (d + polyGridHeaderSize <= data + dataSize)
+	{
+		dtPolyGrid* grid = (dtPolyGrid*)d;
+		// The grid header may be in either byte order, since we can be converting
+		// to or from ours. Only one of them describes the data we have left.
+		dtPolyGrid swapped = *grid;
+		dtSwapEndian(&swapped.width);
+		dtSwapEndian(&swapped.height);
+		dtSwapEndian(&swapped.polyCount);
+		dtSwapEndian(&swapped.cellSize);
+		const int left = (int)(data + dataSize - d);
+		dtPolyGrid native;
+		if (isPolyGridSize(grid, left))
+			native = *grid;
+		else if (isPolyGridSize(&swapped, left))
+			native = swapped;
+		else
+			return false;
+		
+		int* cells = (int*)(d + polyGridHeaderSize);
+		unsigned short* gridPolys = (unsigned short*)((unsigned char*)cells +
+													  dtAlign4(sizeof(int)*(native.width*native.height+1)));
+		dtSwapEndian(&grid->width);
+		dtSwapEndian(&grid->height);
+		dtSwapEndian(&grid->polyCount);
+		dtSwapEndian(&grid->cellSize);
+		for (int i = 0; i < native.width*native.height+1; ++i)
+			dtSwapEndian(&cells[i]);
+		for (int i = 0; i < native.polyCount; ++i)
+			dtSwapEndian(&gridPolys[i]);
+	}
+	
 	return true;
 }
@@ -137,6 +137,7 @@ void dtFreeNavMeshQuery(dtNavMeshQuery* navmesh)
 
 dtNavMeshQuery::dtNavMeshQuery() :
 	m_nav(0),
+	m_heuristic(0),
 	m_tinyNodePool(0),
 	m_nodePool(0),
 	m_openList(0)
@@ -809,6 +810,25 @@ int dtNavMeshQuery::queryPolygonsInTile(const dtMeshTile* tile, const float* qmi
 {
 	dtAssert(m_nav);
 
+	// Small queries are quicker to answer from the polygon grid.
+	unsigned short gridPolys[DT_POLYGRID_MAX_QUERY_POLYS];
+	const int gridPolyCount = dtQueryPolyGrid(tile, qmin, qmax, gridPolys, DT_POLYGRID_MAX_QUERY_POLYS);
+	if (gridPolyCount >= 0)
+	{
+		const dtPolyRef base = m_nav->getPolyRefBase(tile);
+		int n = 0;
+		for (int i = 0; i < gridPolyCount; ++i)
+		{
+			const dtPolyRef ref = base | (dtPolyRef)gridPolys[i];
+			if (filter->passFilter(ref, tile, &tile->polys[gridPolys[i]]))
+			{
+				if (n < maxPolys)
+					polys[n++] = ref;
+			}
+		}
+		return n;
+	}
+
 	if (tile->bvTree)
 	{
 		const dtBVNode* node = &tile->bvTree[0];
@@ -993,13 +1013,13 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 	dtVcopy(startNode->pos, startPos);
 	startNode->pidx = 0;
 	startNode->cost = 0;
-	startNode->total = dtVdist(startPos, endPos) * H_SCALE;
+	startNode->total = getHeuristicCost(startRef, startPos, endRef, endPos);
 	startNode->id = startRef;
 	startNode->flags = DT_NODE_OPEN;
 	m_openList->push(startNode);
 	
 	dtNode* lastBestNode = startNode;
-	float lastBestNodeCost = startNode->total;
+	float lastBestNodeCost = dtVdist(startPos, endPos) * H_SCALE;
 	
 	dtStatus status = DT_SUCCESS;
 	
@@ -1065,9 +1085,11 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 								neighbourNode->pos);
 			}
 
-			// Calculate cost and heuristic.
+			// Calculate cost and heuristic, and distance to the goal for
+			// partial results.
 			float cost = 0;
 			float heuristic = 0;
+			float nearest = 0;
 			
 			// Special case for last node.
 			if (neighbourRef == endRef)
@@ -1093,7 +1115,8 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 													  bestRef, bestTile, bestPoly,
 													  neighbourRef, neighbourTile, neighbourPoly);
 				cost = bestNode->cost + curCost;
-				heuristic = dtVdist(neighbourNode->pos, endPos)*H_SCALE;
+				heuristic = getHeuristicCost(neighbourRef, neighbourNode->pos, endRef, endPos);
+				nearest = dtVdist(neighbourNode->pos, endPos)*H_SCALE;
 			}
 
 			const float total = cost + heuristic;
@@ -1125,9 +1148,9 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 			}
 			
 			// Update nearest node to target so far.
-			if (heuristic < lastBestNodeCost)
+			if (nearest < lastBestNodeCost)
 			{
-				lastBestNodeCost = heuristic;
+				lastBestNodeCost = nearest;
 				lastBestNode = neighbourNode;
 			}
 		}
@@ -1213,14 +1236,14 @@ dtStatus dtNavMeshQuery::initSlicedFindPath(dtPolyRef startRef, dtPolyRef endRef
 	dtVcopy(startNode->pos, startPos);
 	startNode->pidx = 0;
 	startNode->cost = 0;
-	startNode->total = dtVdist(startPos, endPos) * H_SCALE;
+	startNode->total = getHeuristicCost(startRef, startPos, endRef, endPos);
 	startNode->id = startRef;
 	startNode->flags = DT_NODE_OPEN;
 	m_openList->push(startNode);
 	
 	m_query.status = DT_IN_PROGRESS;
 	m_query.lastBestNode = startNode;
-	m_query.lastBestNodeCost = startNode->total;
+	m_query.lastBestNodeCost = dtVdist(startPos, endPos) * H_SCALE;
 	
 	return m_query.status;
 }
@@ -1322,9 +1345,11 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 								neighbourNode->pos);
 			}
 			
-			// Calculate cost and heuristic.
+			// Calculate cost and heuristic, and distance to the goal for
+			// partial results.
 			float cost = 0;
 			float heuristic = 0;
+			float nearest = 0;
 			
 			// Special case for last node.
 			if (neighbourRef == m_query.endRef)
@@ -1350,7 +1375,8 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 															  bestRef, bestTile, bestPoly,
 															  neighbourRef, neighbourTile, neighbourPoly);
 				cost = bestNode->cost + curCost;
-				heuristic = dtVdist(neighbourNode->pos, m_query.endPos)*H_SCALE;
+				heuristic = getHeuristicCost(neighbourRef, neighbourNode->pos, m_query.endRef, m_query.endPos);
+				nearest = dtVdist(neighbourNode->pos, m_query.endPos)*H_SCALE;
 			}
 			
 			const float total = cost + heuristic;
@@ -1382,9 +1408,9 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 			}
 			
 			// Update nearest node to target so far.
-			if (heuristic < m_query.lastBestNodeCost)
+			if (nearest < m_query.lastBestNodeCost)
 			{
-				m_query.lastBestNodeCost = heuristic;
+				m_query.lastBestNodeCost = nearest;
 				m_query.lastBestNode = neighbourNode;
 			}
 		}
@@ -1465,6 +1491,47 @@ dtStatus dtNavMeshQuery::finalizeSlicedFindPath(dtPolyRef* path, int* pathCount,
 	return DT_SUCCESS | details;
 }
 
+/// @par
+///
+/// The path ends at the polygon the search has found nearest to the end position so far,
+/// so it is a prefix of a path that heads the right way, but may be replaced by a
+/// different one once the search completes.
+///
+/// If the path array is too small, the polygons nearest the end of the path are dropped.
+dtStatus dtNavMeshQuery::getSlicedFindPathPartial(dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	*pathCount = 0;
+	
+	if (!dtStatusInProgress(m_query.status) || !m_query.lastBestNode || !maxPath)
+		return DT_FAILURE;
+	
+	// Count the nodes back to the start.
+	int n = 0;
+	for (const dtNode* node = m_query.lastBestNode; node; node = m_nodePool->getNodeAtIdx(node->pidx))
+		n++;
+	
+	dtStatus status = DT_SUCCESS | DT_PARTIAL_RESULT;
+	const dtNode* node = m_query.lastBestNode;
+	if (n > maxPath)
+	{
+		for (int i = 0; i < n - maxPath; ++i)
+			node = m_nodePool->getNodeAtIdx(node->pidx);
+		n = maxPath;
+		status |= DT_BUFFER_TOO_SMALL;
+	}
+	
+	// Store path, leaving the search tree as it is.
+	for (int i = n-1; i >= 0; --i)
+	{
+		path[i] = node->id;
+		node = m_nodePool->getNodeAtIdx(node->pidx);
+	}
+	
+	*pathCount = n;
+	
+	return status;
+}
+
 dtStatus dtNavMeshQuery::finalizeSlicedFindPathPartial(const dtPolyRef* existing, const int existingSize,
 													   dtPolyRef* path, int* pathCount, const int maxPath)
 {
@@ -2141,6 +2208,15 @@ dtStatus dtNavMeshQuery::getEdgeMidPoint(dtPolyRef from, const dtPoly* fromPoly,
 	return DT_SUCCESS;
 }
 
+float dtNavMeshQuery::getHeuristicCost(const dtPolyRef ref, const float* pos,
+									   const dtPolyRef endRef, const float* endPos) const
+{
+	const float h = dtVdist(pos, endPos) * H_SCALE;
+	if (!m_heuristic)
+		return h;
+	return dtMax(h, m_heuristic->getCost(ref, pos, endRef, endPos));
+}
+
 /// @par
 ///
 /// This method is meant to be used for quick, short distance checks.
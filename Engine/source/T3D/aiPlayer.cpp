@@ -24,6 +24,8 @@
 #include "T3D/aiPlayer.h"
 
 #include "console/consoleInternal.h"
+#include "console/consoleTypes.h"
+#include "console/simEvents.h"
 #include "math/mMatrix.h"
 #include "T3D/gameBase/moveManager.h"
 #include "console/engineAPI.h"
@@ -32,6 +34,16 @@ static U32 sAIPlayerLoSMask = TerrainObjectType | StaticShapeObjectType | Static
 
 IMPLEMENT_CO_NETOBJECT_V1(AIPlayer);
 
+#ifdef TORQUE_WALKABOUT_ENABLED
+ImplementEnumType(AIPlayerPathMode,
+   "How an AIPlayer plans paths.\n\n"
+   "@ingroup AI\n")
+   { AIPlayer::InstantPath, "Instant", "Plan the whole path as soon as it is requested.\n" },
+   { AIPlayer::SlicedPath,  "Sliced",  "Plan over several ticks within the NavMesh's pathBudget.\n" },
+   { AIPlayer::ThreadedPath, "Threaded", "Plan on a worker thread, against the NavMesh as it was when planning started.\n" },
+EndImplementEnumType;
+#endif // TORQUE_WALKABOUT_ENABLED
+
 ConsoleDocClass( AIPlayer,
 	"@brief A Player object not controlled by conventional input, but by an AI engine.\n\n"
 
@@ -51,6 +63,14 @@ ConsoleDocClass( AIPlayer,
    "The actual point at which this callback is called is when the AIPlayer is within the mMoveTolerance "
    "of the defined destination.\n\n"
 
+   "void onPathFound(AIPlayer obj) \n"
+   "Called when a path requested with setPathDestination() has finished planning, if the "
+   "AIPlayer's pathMode is not Instant.\n\n"
+
+   "void onPathFailed(AIPlayer obj) \n"
+   "Called when a path requested with setPathDestination() could not be planned, if the "
+   "AIPlayer's pathMode is not Instant.\n\n"
+
    "void onMoveStuck(AIPlayer obj) \n"
    "While in motion, if an AIPlayer has moved less than moveStuckTolerance within a single tick, this "
    "callback is called.  From here you could choose an alternate destination to get the AIPlayer moving "
@@ -104,6 +124,8 @@ AIPlayer::AIPlayer()
    mJump = None;
    mNavSize = Regular;
    mLinkTypes = LinkData(AllFlags);
+   mPathMode = InstantPath;
+   mPathPriority = 0;
 #endif // TORQUE_WALKABOUT_ENABLED
 
    mIsAiControlled = true;
@@ -116,6 +138,22 @@ AIPlayer::~AIPlayer()
 {
 }
 
+#ifdef TORQUE_WALKABOUT_ENABLED
+bool AIPlayer::smRenderPaths = false;
+#endif // TORQUE_WALKABOUT_ENABLED
+
+void AIPlayer::consoleInit()
+{
+#ifdef TORQUE_WALKABOUT_ENABLED
+   Con::addVariable("$AIPlayer::renderPaths", TypeBool, &smRenderPaths,
+      "@brief Register the paths AIPlayers plan, so they can be rendered.\n\n"
+      "When false, AIPlayers keep their paths to themselves, which saves adding "
+      "them to the scene and ghosting them to clients. Only affects paths "
+      "planned after it is changed.\n\n"
+      "@ingroup AI\n");
+#endif // TORQUE_WALKABOUT_ENABLED
+}
+
 void AIPlayer::initPersistFields()
 {
    addGroup( "AI" );
@@ -160,6 +198,11 @@ void AIPlayer::initPersistFields()
    addField("allowTeleport", TypeBool, Offset(mLinkTypes.teleport, AIPlayer),
       "Allow the character to use teleporters.");
 
+   addField("pathMode", TYPEID<AIPlayerPathMode>(), Offset(mPathMode, AIPlayer),
+      "How paths requested by setPathDestination are planned.");
+   addField("pathPriority", TypeS32, Offset(mPathPriority, AIPlayer),
+      "Priority of this character's sliced paths. Higher priorities are planned first.");
+
    endGroup("Pathfinding");
 #endif // TORQUE_WALKABOUT_ENABLED
 
@@ -185,6 +228,7 @@ void AIPlayer::onRemove()
    clearPath();
    clearCover();
    clearFollow();
+   clearFlow();
    Parent::onRemove();
 }
 #endif // TORQUE_WALKABOUT_ENABLED
@@ -209,6 +253,7 @@ void AIPlayer::stopMove()
    clearPath();
    clearCover();
    clearFollow();
+   clearFlow();
 #endif // TORQUE_WALKABOUT_ENABLED
 }
 
@@ -312,9 +357,21 @@ bool AIPlayer::getAIMove(Move *movePtr)
             if((getPosition() - mFollowData.object->getPosition()).len() > mFollowData.radius)
                followObject(mFollowData.object, mFollowData.radius);
          }
-         else
+         // Don't restart a path that's still being planned.
+         else if(!mPathData.path->isPlanning())
          {
-            if((mPathData.path->mTo - mFollowData.object->getPosition()).len() > mFollowData.radius)
+            if(mCorridorData.active)
+            {
+               if((getPosition() - mFollowData.object->getPosition()).len() < mFollowData.radius)
+               {
+                  clearPath();
+                  mMoveState = ModeStop;
+               }
+               // Only replan once the corridor can't be stretched to them.
+               else if(!followCorridor())
+                  repath();
+            }
+            else if((mPathData.path->mTo - mFollowData.object->getPosition()).len() > mFollowData.radius)
                repath();
             else if((getPosition() - mFollowData.object->getPosition()).len() < mFollowData.radius)
             {
@@ -566,6 +623,32 @@ void AIPlayer::throwCallback( const char *name )
  */
 void AIPlayer::onReachDestination()
 {
+   if(!mFlowData.field.isNull())
+   {
+      if(mFlowData.poly)
+         moveToFlow(false);
+      else
+      {
+         clearFlow();
+         throwCallback("onReachDestination");
+      }
+      return;
+   }
+   // Wait for our path to finish planning, after moving along as much of
+   // it as has been found.
+   if(!mPathData.path.isNull() && mPathData.path->isPlanning())
+   {
+      if(mPathData.path->isPartial() && mPathData.index < mPathData.path->size() - 1)
+         moveToNode(mPathData.index + 1);
+      return;
+   }
+   // Corners of a corridor are picked as we go, so just note that we've
+   // landed if we were crossing a link.
+   if(mCorridorData.active)
+   {
+      mCorridorData.offMesh = false;
+      return;
+   }
    if(!mPathData.path.isNull())
    {
       if(mPathData.index == mPathData.path->size() - 1)
@@ -598,7 +681,9 @@ void AIPlayer::onReachDestination()
  */
 void AIPlayer::onStuck()
 {
-   if(!mPathData.path.isNull())
+   if(!mFlowData.field.isNull())
+      moveToFlow(true);
+   else if(!mPathData.path.isNull())
       repath();
    else
       throwCallback("onMoveStuck");
@@ -610,18 +695,47 @@ void AIPlayer::onStuck()
 
 void AIPlayer::clearPath()
 {
+   if(!mPathData.path.isNull())
+   {
+      mPathData.path->mPlannedSignal.remove(this, &AIPlayer::onPathPlanned);
+      mPathData.path->mPartialSignal.remove(this, &AIPlayer::onPathPartial);
+   }
    // Only delete if we own the path.
    if(!mPathData.path.isNull() && mPathData.owned)
-      mPathData.path->deleteObject();
+      deleteOwnedPath(mPathData.path);
    // Reset path data.
    mPathData = PathData();
+   clearCorridor();
+}
+
+/// Deletes a NavPath that was never registered. The path goes when the
+/// event does, so it is freed even if the event is cancelled.
+class AIPathDeleteEvent : public SimEvent
+{
+public:
+   AIPathDeleteEvent(NavPath *path) : mPath(path) {}
+   ~AIPathDeleteEvent() { delete mPath; }
+   virtual void process(SimObject *object) {}
+
+private:
+   NavPath *mPath;
+};
+
+void AIPlayer::deleteOwnedPath(NavPath *path)
+{
+   // We are often called from the path's own signals, so it can't be
+   // deleted until they have finished.
+   if(path->isProperlyAdded())
+      path->safeDeleteObject();
+   else
+      Sim::postEvent(Sim::getRootGroup(), new AIPathDeleteEvent(path), Sim::getCurrentTime());
 }
 
 void AIPlayer::clearCover()
 {
    // Notify cover that we are no longer on our way.
-   if(!mCoverData.cover.isNull())
-      mCoverData.cover->setOccupied(false);
+   if(!mCoverData.mesh.isNull())
+      mCoverData.mesh->setCoverOccupied(mCoverData.ref, false);
    mCoverData = CoverData();
 }
 
@@ -630,6 +744,198 @@ void AIPlayer::clearFollow()
    mFollowData = FollowData();
 }
 
+void AIPlayer::clearFlow()
+{
+   mFlowData = FlowData();
+}
+
+void AIPlayer::clearCorridor()
+{
+   // The corridor keeps its buffer for next time.
+   mCorridorData.active = false;
+   mCorridorData.offMesh = false;
+}
+
+void AIPlayer::startPath()
+{
+   const bool partial = mPathData.partial;
+   mPathData.partial = false;
+   // Followers steer along the path's polygons, so it can be adjusted as
+   // they and their target move.
+   if(!mFollowData.object.isNull() && startCorridor())
+      return;
+   // We may be part way along a partial result of the plan.
+   if(partial)
+   {
+      resumePath();
+      return;
+   }
+   // Skip node 0, which we were standing on when we asked.
+   moveToNode(1);
+}
+
+void AIPlayer::resumePath()
+{
+   NavPath *path = getPath();
+   if(!path || path->size() < 2)
+      return;
+
+   const Point3F pos = getPosition();
+   S32 best = 1;
+   F32 bestDist = F32_MAX;
+   for(S32 i = 1; i < path->size(); i++)
+   {
+      const Point3F a = path->getNode(i - 1);
+      const VectorF seg = path->getNode(i) - a;
+      const F32 segLen = seg.lenSquared();
+      F32 t = segLen > 0.0f ? mDot(pos - a, seg) / segLen : 0.0f;
+      t = mClampF(t, 0.0f, 1.0f);
+      const F32 dist = (a + seg * t - pos).lenSquared();
+      if(dist < bestDist)
+      {
+         bestDist = dist;
+         best = i;
+      }
+   }
+   moveToNode(best);
+}
+
+bool AIPlayer::startCorridor()
+{
+   NavPath *path = getPath();
+   NavMesh *mesh = getNavMesh();
+   if(!path || !mesh || path->mMesh != mesh || !path->success() ||
+      !path->getCorridor().size() || !path->size())
+      return false;
+
+   dtPathCorridor &c = mCorridorData.corridor;
+   if(!c.getPath() && !c.init(MaxCorridorPolys))
+      return false;
+
+   mCorridorData.filter.setIncludeFlags(mLinkTypes.getFlags());
+
+   // Start where the path did, unless we've moved on since it was planned
+   // and are still inside it. The corridor is moved to us as we follow it.
+   const Vector<dtPolyRef> &polys = path->getCorridor();
+   U32 first = 0;
+   Point3F start = DTStoRC(path->getNode(0));
+   dtNavMeshQuery *query = mesh->acquireQuery();
+   if(query)
+   {
+      const F32 extents[] = {mesh->mWalkableRadius * 2.0f, mesh->mWalkableHeight, mesh->mWalkableRadius * 2.0f};
+      dtPolyRef ref = 0;
+      F32 nearest[3];
+      if(dtStatusSucceed(query->findNearestPoly(DTStoRC(getPosition()), extents, &mCorridorData.filter, &ref, nearest)))
+      {
+         for(U32 i = 0; i < polys.size(); i++)
+         {
+            if(polys[i] == ref)
+            {
+               first = i;
+               start.set(nearest[0], nearest[1], nearest[2]);
+               break;
+            }
+         }
+      }
+      mesh->releaseQuery(query);
+   }
+   // Hierarchical and cached corridors can be any length. Follow the nodes
+   // of those that won't fit.
+   if(polys.size() - first > MaxCorridorPolys)
+      return false;
+   c.reset(polys[first], start);
+   c.setCorridor(DTStoRC(path->getNode(path->size() - 1)), polys.address() + first, polys.size() - first);
+   mCorridorData.active = true;
+   mCorridorData.offMesh = false;
+   mCorridorData.optimiseCountdown = CorridorOptimiseTicks;
+
+   if(!followCorridor())
+   {
+      clearCorridor();
+      return false;
+   }
+   return true;
+}
+
+bool AIPlayer::followCorridor()
+{
+   NavMesh *mesh = getNavMesh();
+   if(!mesh || !mesh->getNavMesh() || mFollowData.object.isNull())
+      return false;
+
+   // Wait until we land before moving the corridor with us.
+   if(mCorridorData.offMesh)
+      return true;
+
+   dtNavMeshQuery *query = mesh->acquireQuery();
+   if(!query)
+      return false;
+
+   dtPathCorridor &c = mCorridorData.corridor;
+   const dtQueryFilter *filter = &mCorridorData.filter;
+   const Point3F target = mFollowData.object->getPosition();
+   c.movePosition(DTStoRC(getPosition()), query, filter);
+   c.moveTargetPosition(DTStoRC(target), query, filter);
+
+   // The corridor is broken by a tile rebuild, or our target has gone
+   // somewhere it can't be stretched to.
+   bool valid = c.isValid(MaxCorridorPolys, query, filter) &&
+                (RCtoDTS(c.getTarget()) - target).len() < mFollowData.radius;
+
+   static const U32 MaxCorners = 4;
+   F32 corners[MaxCorners * 3];
+   U8 cornerFlags[MaxCorners];
+   dtPolyRef cornerPolys[MaxCorners];
+   S32 count = 0;
+   if(valid)
+   {
+      count = c.findCorners(corners, cornerFlags, cornerPolys, MaxCorners, query, filter);
+      if(count)
+      {
+         // Cut corners we can see past, and now and then look for a
+         // shorter way through the polygons around us.
+         c.optimizePathVisibility(&corners[(count - 1) * 3], mesh->mWalkableRadius * 30.0f, query, filter);
+         if(--mCorridorData.optimiseCountdown <= 0)
+         {
+            c.optimizePathTopology(query, filter);
+            mCorridorData.optimiseCountdown = CorridorOptimiseTicks;
+         }
+         count = c.findCorners(corners, cornerFlags, cornerPolys, MaxCorners, query, filter);
+      }
+   }
+
+   if(valid)
+   {
+      Point3F dest = count ? RCtoDTS(corners) : RCtoDTS(c.getTarget());
+      VectorF toDest = dest - getPosition();
+      toDest.z = 0.0f;
+      // Cross off-mesh links once we're at their start.
+      dtPolyRef refs[2];
+      F32 linkStart[3], linkEnd[3];
+      if(count && (cornerFlags[0] & DT_STRAIGHTPATH_OFFMESH_CONNECTION) &&
+         toDest.len() < mMoveTolerance * 2.0f &&
+         c.moveOverOffmeshConnection(cornerPolys[0], refs, linkStart, linkEnd, query))
+      {
+         U16 flags = 0;
+         mesh->getNavMesh()->getPolyFlags(cornerPolys[0], &flags);
+         if(flags & LedgeFlag)
+            mJump = Ledge;
+         else if(flags & JumpFlag)
+            mJump = Now;
+         else
+            mJump = None;
+         mCorridorData.offMesh = true;
+         dest = RCtoDTS(linkEnd);
+      }
+      // Don't reset our stuck test unless we have somewhere new to go.
+      if(mMoveState == ModeStop || (dest - mMoveDestination).lenSquared() > 0.01f)
+         setMoveDestination(dest, false);
+   }
+
+   mesh->releaseQuery(query);
+   return valid;
+}
+
 void AIPlayer::moveToNode(S32 node)
 {
    if(mPathData.path.isNull())
@@ -683,25 +989,54 @@ bool AIPlayer::setPathDestination(const Point3F &pos)
       path->mFrom = getPosition();
       path->mTo = pos;
       path->mFromSet = path->mToSet = true;
-      path->mAlwaysRender = true;
+      path->mAlwaysRender = smRenderPaths;
       path->mLinkTypes = mLinkTypes;
-      path->mXray = true;
-      // Paths plan automatically upon being registered.
-      if(!path->registerObject())
+      path->mXray = smRenderPaths;
+      if(mPathMode == ThreadedPath)
+         path->mIsThreaded = true;
+      else if(mPathMode == SlicedPath)
       {
-         delete path;
-         return false;
+         path->mIsSliced = true;
+         path->mPriority = mPathPriority;
+         // Let our NavMesh's budget be the only limit.
+         path->mMaxIterations = S32_MAX;
       }
+      // Paths plan automatically upon being registered. Otherwise, the path
+      // is ours alone, and we plan it ourselves.
+      if(smRenderPaths)
+      {
+         if(!path->registerObject())
+         {
+            delete path;
+            return false;
+         }
+      }
+      else
+         path->plan();
    }
    else
       return false;
 
-   if(path->success())
+   if(path->isPlanning())
+   {
+      // Start following it once it's done.
+      clearPath();
+      clearCover();
+      clearFollow();
+      clearFlow();
+      mPathData.path = path;
+      mPathData.owned = true;
+      path->mPlannedSignal.notify(this, &AIPlayer::onPathPlanned);
+      path->mPartialSignal.notify(this, &AIPlayer::onPathPartial);
+      return true;
+   }
+   else if(path->success())
    {
       // Clear any current path we might have.
       clearPath();
       clearCover();
       clearFollow();
+      clearFlow();
       // Store new path.
       mPathData.path = path;
       mPathData.owned = true;
@@ -715,16 +1050,46 @@ bool AIPlayer::setPathDestination(const Point3F &pos)
       //setMoveDestination(pos, true);
       //return;
       //throwCallback("onPathFailed");
-      path->deleteObject();
+      deleteOwnedPath(path);
       return false;
    }
 }
 
+void AIPlayer::onPathPlanned(NavPath *path, bool success)
+{
+   if(path != mPathData.path)
+      return;
+   if(success)
+   {
+      startPath();
+      throwCallback("onPathFound");
+   }
+   else
+   {
+      // Don't carry on along a partial result.
+      if(mPathData.partial)
+         mMoveState = ModeStop;
+      clearPath();
+      throwCallback("onPathFailed");
+   }
+}
+
+void AIPlayer::onPathPartial(NavPath *path)
+{
+   if(path != mPathData.path)
+      return;
+   // Start along the way found so far; we'll switch to the full path when
+   // it's ready.
+   mPathData.partial = true;
+   moveToNode(1);
+}
+
 DefineEngineMethod(AIPlayer, setPathDestination, bool, (Point3F goal),,
    "@brief Tells the AI to find a path to the location provided\n\n"
 
    "@param goal Coordinates in world space representing location to move to.\n"
-   "@return True if a path was found.\n\n"
+   "@return True if a path was found, or if it is being planned and onPathFound or "
+   "onPathFailed will be called later.\n\n"
 
    "@see getPathDestination()\n"
    "@see setMoveDestination()\n")
@@ -760,6 +1125,7 @@ void AIPlayer::followNavPath(NavPath *path)
    clearPath();
    clearCover();
    clearFollow();
+   clearFlow();
 
    // Follow new path.
    mPathData.path = path;
@@ -788,6 +1154,8 @@ void AIPlayer::followObject(SceneObject *obj, F32 radius)
       clearCover();
       mFollowData.object = obj;
       mFollowData.radius = radius;
+      if(!mPathData.path->isPlanning())
+         startPath();
    }
 }
 
@@ -802,20 +1170,77 @@ DefineEngineMethod(AIPlayer, followObject, void, (SimObjectId obj, F32 radius),,
       object->followObject(follow, radius);
 }
 
+void AIPlayer::followFlowField(NavFlowField *field)
+{
+   if(!isServerObject())
+      return;
+
+   clearPath();
+   clearCover();
+   clearFollow();
+   clearFlow();
+
+   mFlowData.field = field;
+   moveToFlow(true);
+}
+
+DefineEngineMethod(AIPlayer, followFlowField, void, (SimObjectId obj),,
+   "@brief Tell the AIPlayer to follow a NavFlowField to its goal.\n\n"
+
+   "Many characters can share one field, instead of each planning its own path.\n\n"
+
+   "@param obj ID of the NavFlowField to follow.")
+{
+   NavFlowField *field;
+   if(Sim::findObject(obj, field))
+      object->followFlowField(field);
+}
+
+void AIPlayer::moveToFlow(bool relocate)
+{
+   NavFlowField *field = mFlowData.field;
+   if(!field)
+      return;
+
+   if(relocate)
+      mFlowData.poly = field->findPoly(getPosition());
+
+   dtPolyRef next;
+   Point3F point;
+   if(!field->getNext(mFlowData.poly, next, point))
+   {
+      // The field may have changed under us; see where we really are.
+      if(!relocate)
+      {
+         moveToFlow(true);
+         return;
+      }
+      clearFlow();
+      mMoveState = ModeStop;
+      throwCallback("onPathFailed");
+      return;
+   }
+
+   setMoveDestination(point, false);
+   mFlowData.poly = next;
+}
+
 void AIPlayer::repath()
 {
    // Ineffectual if we don't have a path, or are using someone else's.
    if(mPathData.path.isNull() || !mPathData.owned)
       return;
 
+   clearCorridor();
    // If we're following, get their position.
    if(!mFollowData.object.isNull())
       mPathData.path->mTo = mFollowData.object->getPosition();
    // Update from position and replan.
    mPathData.path->mFrom = getPosition();
    mPathData.path->plan();
-   // Move to first node (skip start pos).
-   moveToNode(1);
+   // Start moving, unless we have to wait.
+   if(!mPathData.path->isPlanning())
+      startPath();
 }
 
 DefineEngineMethod(AIPlayer, repath, void, (),,
@@ -825,89 +1250,43 @@ DefineEngineMethod(AIPlayer, repath, void, (),,
    object->repath();
 }
 
-struct CoverSearch
-{
-   Point3F loc;
-   Point3F from;
-   F32 dist;
-   F32 best;
-   CoverPoint *point;
-   CoverSearch() : loc(0, 0, 0), from(0, 0, 0)
-   {
-      best = -FLT_MAX;
-      point = NULL;
-      dist = FLT_MAX;
-   }
-};
-
-static void findCoverCallback(SceneObject *obj, void *key)
-{
-   CoverPoint *p = dynamic_cast<CoverPoint*>(obj);
-   if(!p || p->isOccupied())
-      return;
-   CoverSearch *s = static_cast<CoverSearch*>(key);
-   Point3F dir = s->from - p->getPosition();
-   dir.normalizeSafe();
-   // Score first based on angle of cover point to enemy.
-   F32 score = mDot(p->getNormal(), dir);
-   // Score also based on distance from seeker.
-   score -= (p->getPosition() - s->loc).len() / s->dist;
-   // Finally, consider cover size.
-   score += (p->getSize() + 1) / CoverPoint::NumSizes;
-   score *= p->getQuality();
-   if(score > s->best)
-   {
-      s->best = score;
-      s->point = p;
-   }
-}
-
 bool AIPlayer::findCover(const Point3F &from, F32 radius)
 {
    if(radius <= 0)
       return false;
 
-   // Create a search state.
-   CoverSearch s;
-   s.loc = getPosition();
-   s.dist = radius;
-   // Direction we seek cover FROM.
-   s.from = from;
+   if(!getNavMesh())
+      updateNavMesh();
+   NavMesh *mesh = getNavMesh();
+   if(!mesh)
+      return false;
 
-   // Find cover points.
-   Box3F box(radius * 2.0f);
-   box.setCenter(getPosition());
-   getContainer()->findObjects(box, MarkerObjectType, findCoverCallback, &s);
+   // Find and reserve a cover point, so nobody else picks it.
+   NavMesh::CoverRef ref = mesh->findCover(getPosition(), from, radius, true);
 
    // Go to cover!
-   if(s.point)
+   if(ref != NavMesh::NullCover)
    {
       // Calling setPathDestination clears cover...
-      bool foundPath = setPathDestination(s.point->getPosition());
+      bool foundPath = setPathDestination(mesh->getCoverPosition(ref));
       // Now store the cover info.
-      mCoverData.cover = s.point;
-      s.point->setOccupied(true);
+      mCoverData.mesh = mesh;
+      mCoverData.ref = ref;
       return foundPath;
    }
    return false;
 }
 
-DefineEngineMethod(AIPlayer, findCover, S32, (Point3F from, F32 radius),,
+DefineEngineMethod(AIPlayer, findCover, const char*, (Point3F from, F32 radius),,
    "@brief Tells the AI to find cover nearby.\n\n"
 
    "@param from   Location to find cover from (i.e., enemy position).\n"
    "@param radius Distance to search for cover.\n"
-   "@return Cover point ID if cover was found, -1 otherwise.\n\n")
+   "@return Cover reference in the character's NavMesh if cover was found, -1 otherwise.\n\n")
 {
    if(object->findCover(from, radius))
-   {
-      CoverPoint* cover = object->getCover();
-      return cover ? cover->getId() : -1;
-   }
-   else
-   {
-      return -1;
-   }
+      return NavMesh::getCoverRefString(object->getCover());
+   return NavMesh::getCoverRefString(NavMesh::NullCover);
 }
 
 NavMesh *AIPlayer::findNavMesh() const
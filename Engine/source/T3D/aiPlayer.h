@@ -31,6 +31,8 @@
 #include "walkabout/navPath.h"
 #include "walkabout/navMesh.h"
 #include "walkabout/coverPoint.h"
+#include "walkabout/navFlowField.h"
+#include <DetourPathCorridor.h>
 #endif // TORQUE_WALKABOUT_ENABLED
 
 class AIPlayer : public Player {
@@ -69,7 +71,7 @@ private:
 #ifdef TORQUE_WALKABOUT_ENABLED
 public:
    /// Get cover we are moving to.
-   CoverPoint *getCover() { return mCoverData.cover; }
+   NavMesh::CoverRef getCover() const { return mCoverData.ref; }
 
 private:
    /// Should we jump?
@@ -87,17 +89,27 @@ private:
       bool owned;
       /// Path node we're at.
       U32 index;
+      /// Have we started along a partial result of the path's plan?
+      bool partial;
       /// Default constructor.
       PathData() : path(NULL)
       {
          owned = false;
          index = 0;
+         partial = false;
       }
    };
 
    /// Path we are currently following.
    PathData mPathData;
 
+   /// Register the paths we plan, so they are rendered and sent to clients?
+   /// Otherwise they are never added to the simulation or the scene.
+   static bool smRenderPaths;
+
+   /// Delete a path we created, once whatever is using it has finished.
+   static void deleteOwnedPath(NavPath *path);
+
    /// Clear out the current path.
    void clearPath();
 
@@ -106,10 +118,12 @@ private:
 
    /// Stores information about our cover.
    struct CoverData {
-      /// Pointer to a cover point.
-      SimObjectPtr<CoverPoint> cover;
+      /// NavMesh the cover point belongs to.
+      SimObjectPtr<NavMesh> mesh;
+      /// Reference to the cover point within the mesh.
+      NavMesh::CoverRef ref;
       /// Default constructor.
-      CoverData() : cover(NULL)
+      CoverData() : mesh(NULL), ref(NavMesh::NullCover)
       {
       }
    };
@@ -136,15 +150,95 @@ private:
    /// Current object we're following.
    FollowData mFollowData;
 
+   /// Stores information about a flow field we're following.
+   struct FlowData {
+      /// Field to follow.
+      SimObjectPtr<NavFlowField> field;
+      /// Polygon we're moving into, or 0 if we're heading for the goal.
+      dtPolyRef poly;
+      /// Default constructor.
+      FlowData() : field(NULL)
+      {
+         poly = 0;
+      }
+   };
+
+   /// Current flow field we're following.
+   FlowData mFlowData;
+
+   /// Stop following a flow field.
+   void clearFlow();
+
+   /// Head for the next point given by our flow field.
+   /// @param relocate Find which polygon we're on first.
+   void moveToFlow(bool relocate);
+
    /// Stop following me!
    void clearFollow();
 
+   /// Polygons we steer along while following an object. Their ends are
+   /// moved with us and our target each tick, so the path only needs
+   /// replanning when they can't be.
+   struct CorridorData {
+      /// Corridor from our position to the target's.
+      dtPathCorridor corridor;
+      /// Filter matching our link types.
+      dtQueryFilter filter;
+      /// Are we steering along the corridor?
+      bool active;
+      /// Are we crossing an off-mesh link? The corridor already starts at
+      /// its far end, so it isn't moved until we land.
+      bool offMesh;
+      /// Ticks until we next search for a shorter corridor.
+      S32 optimiseCountdown;
+      /// Default constructor.
+      CorridorData()
+      {
+         active = false;
+         offMesh = false;
+         optimiseCountdown = 0;
+      }
+   };
+
+   /// Corridor we're steering along.
+   CorridorData mCorridorData;
+
+   /// Most polygons our corridor can hold.
+   static const U32 MaxCorridorPolys = 1024;
+   /// Ticks between searches for a shorter corridor around us.
+   static const S32 CorridorOptimiseTicks = 16;
+
+   /// Steer along the polygons of our current path instead of its nodes.
+   /// @return False if the path has no polygons we can follow.
+   bool startCorridor();
+
+   /// Stop steering along a corridor.
+   void clearCorridor();
+
+   /// Move our corridor's ends to us and our target, and head for its
+   /// next corner.
+   /// @return False if the corridor can't be followed any more and we
+   ///         must replan.
+   bool followCorridor();
+
+   /// Start moving along a path that has just been planned.
+   void startPath();
+
    /// NavMesh we pathfind on.
    SimObjectPtr<NavMesh> mNavMesh;
 
    /// Move to the specified node in the current path.
    void moveToNode(S32 node);
 
+   /// Called by our NavPath when a sliced plan finishes.
+   void onPathPlanned(NavPath *path, bool success);
+
+   /// Called by our NavPath when a sliced plan has a partial result.
+   void onPathPartial(NavPath *path);
+
+   /// Carry on from the node after the path segment nearest to us.
+   void resumePath();
+
 protected:
    virtual void onReachDestination();
    virtual void onStuck();
@@ -157,6 +251,7 @@ public:
    ~AIPlayer();
 
    static void initPersistFields();
+   static void consoleInit();
 
    bool onAdd();
 #ifdef TORQUE_WALKABOUT_ENABLED
@@ -201,6 +296,7 @@ public:
 
    void followNavPath(NavPath *path);
    void followObject(SceneObject *obj, F32 radius);
+   void followFlowField(NavFlowField *field);
 
    void repath();
 
@@ -213,8 +309,23 @@ public:
    /// Types of link we can use.
    LinkData mLinkTypes;
 
+   /// How we plan paths.
+   enum PathMode {
+      InstantPath, ///< Plan the whole path as soon as it is requested.
+      SlicedPath,  ///< Plan over several ticks within our NavMesh's budget.
+      ThreadedPath, ///< Plan on a worker thread.
+   } mPathMode;
+
+   /// Priority of our sliced paths in our NavMesh's queue.
+   S32 mPathPriority;
+
    /// @}
 #endif // TORQUE_WALKABOUT_ENABLED
 };
 
+#ifdef TORQUE_WALKABOUT_ENABLED
+typedef AIPlayer::PathMode AIPlayerPathMode;
+DefineEnumType(AIPlayerPathMode);
+#endif // TORQUE_WALKABOUT_ENABLED
+
 #endif
@@ -21,6 +21,7 @@
 //-----------------------------------------------------------------------------
 
 #include "coverPoint.h"
+#include "navMesh.h"
 
 #include "math/mathIO.h"
 #include "scene/sceneRenderState.h"
@@ -106,6 +107,8 @@ bool CoverPoint::onAdd()
 
    addToScene();
 
+   notifyMeshes(getWorldBox());
+
    return true;
 }
 
@@ -116,6 +119,9 @@ void CoverPoint::onRemove()
 
    removeFromScene();
 
+   // Only once we're out of the scene, so the meshes don't find us again.
+   notifyMeshes(getWorldBox());
+
    Parent::onRemove();
 
    for(U32 i = 0; i < NumSizes; i++)
@@ -124,8 +130,14 @@ void CoverPoint::onRemove()
 
 void CoverPoint::setTransform(const MatrixF & mat)
 {
+   Box3F old = getWorldBox();
    Parent::setTransform(mat);
    setMaskBits(TransformMask);
+   if(isProperlyAdded())
+   {
+      notifyMeshes(old);
+      notifyMeshes(getWorldBox());
+   }
 }
 
 void CoverPoint::onEditorEnable()
@@ -141,6 +153,23 @@ void CoverPoint::onEditorDisable()
 void CoverPoint::inspectPostApply()
 {
    setMaskBits(TransformMask);
+   // Our size, quality or peek flags may have changed.
+   notifyMeshes(getWorldBox());
+}
+
+void CoverPoint::notifyMeshes(const Box3F &box)
+{
+   // NavMeshes make display proxies that aren't saved; those aren't cover
+   // in their own right.
+   if(!isServerObject() || !getCanSave())
+      return;
+   SimSet *set = NavMesh::getServerSet();
+   for(U32 i = 0; i < set->size(); i++)
+   {
+      NavMesh *m = static_cast<NavMesh*>(set->at(i));
+      if(m->getWorldBox().isOverlapped(box))
+         m->updateCoverPoints(box);
+   }
 }
 
 U32 CoverPoint::packUpdate(NetConnection *conn, U32 mask, BitStream *stream)
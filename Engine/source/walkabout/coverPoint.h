@@ -108,6 +108,8 @@ public:
    /// @}
 
 protected:
+   /// Tell NavMeshes overlapping a box to re-import their cover points.
+   void notifyMeshes(const Box3F &box);
 
 private:
    typedef GFXVertexPCN VertexType;
@@ -0,0 +1,228 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2014 Daniel Buckmaster
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "navConnectivity.h"
+
+#include "platform/profiler.h"
+
+NavMeshConnectivity::NavMeshConnectivity()
+{
+   includeFlags = excludeFlags = 0;
+   meshVersion = tileVersion = 0;
+   mReachWords = 0;
+}
+
+bool NavMeshConnectivity::getIndex(const dtNavMesh *nm, dtPolyRef ref, U32 &idx) const
+{
+   U32 salt, it, ip;
+   nm->decodePolyId(ref, salt, it, ip);
+   if(it >= mTileSalt.size() || mTileSalt[it] != salt)
+      return false;
+   idx = mTileBase[it] + ip;
+   return idx < mComponent.size();
+}
+
+static U32 findIsland(Vector<U32> &sets, U32 i)
+{
+   while(sets[i] != i)
+   {
+      sets[i] = sets[sets[i]];
+      i = sets[i];
+   }
+   return i;
+}
+
+void NavMeshConnectivity::build(const dtNavMesh *nm, const dtQueryFilter &filter)
+{
+   PROFILE_SCOPE(NavMeshConnectivity_build);
+
+   includeFlags = filter.getIncludeFlags();
+   excludeFlags = filter.getExcludeFlags();
+
+   // Give every polygon an index.
+   const S32 maxTiles = nm->getMaxTiles();
+   mTileBase.setSize(maxTiles);
+   mTileSalt.setSize(maxTiles);
+   U32 count = 0;
+   for(S32 i = 0; i < maxTiles; i++)
+   {
+      const dtMeshTile *tile = nm->getTile(i);
+      mTileBase[i] = count;
+      mTileSalt[i] = tile && tile->header ? tile->salt : 0;
+      if(tile && tile->header)
+         count += tile->header->polyCount;
+   }
+
+   // Polygons and their links, as plain indices.
+   Vector<U32> firstEdge, edges;
+   firstEdge.setSize(count + 1);
+   mComponent.setSize(count);
+   U32 p = 0;
+   for(S32 i = 0; i < maxTiles; i++)
+   {
+      const dtMeshTile *tile = nm->getTile(i);
+      if(!tile || !tile->header)
+         continue;
+      const dtPolyRef base = nm->getPolyRefBase(tile);
+      for(S32 j = 0; j < tile->header->polyCount; j++, p++)
+      {
+         firstEdge[p] = edges.size();
+         const dtPoly *poly = &tile->polys[j];
+         const bool pass = filter.passFilter(base | j, tile, poly);
+         mComponent[p] = pass ? 0 : NoComponent;
+         if(!pass)
+            continue;
+         for(U32 l = poly->firstLink; l != DT_NULL_LINK; l = tile->links[l].next)
+         {
+            const dtPolyRef ref = tile->links[l].ref;
+            const dtMeshTile *ntile;
+            const dtPoly *npoly;
+            U32 idx;
+            if(!ref || !getIndex(nm, ref, idx))
+               continue;
+            nm->getTileAndPolyByRefUnsafe(ref, &ntile, &npoly);
+            if(filter.passFilter(ref, ntile, npoly))
+               edges.push_back(idx);
+         }
+      }
+   }
+   firstEdge[count] = edges.size();
+
+   // Tarjan's algorithm, without recursion. Components are numbered so
+   // that edges between them always lead to a lower number.
+   Vector<U32> index, low, stack, callStack, callEdge;
+   Vector<bool> onStack;
+   index.setSize(count);
+   low.setSize(count);
+   onStack.setSize(count);
+   for(U32 i = 0; i < count; i++)
+   {
+      index[i] = NoComponent;
+      onStack[i] = false;
+   }
+   U32 nextIndex = 0, components = 0;
+   for(U32 root = 0; root < count; root++)
+   {
+      if(mComponent[root] == NoComponent || index[root] != NoComponent)
+         continue;
+      callStack.push_back(root);
+      callEdge.push_back(firstEdge[root]);
+      index[root] = low[root] = nextIndex++;
+      stack.push_back(root);
+      onStack[root] = true;
+      while(callStack.size())
+      {
+         const U32 v = callStack.last();
+         U32 &e = callEdge.last();
+         if(e < firstEdge[v + 1])
+         {
+            const U32 w = edges[e++];
+            if(index[w] == NoComponent)
+            {
+               index[w] = low[w] = nextIndex++;
+               stack.push_back(w);
+               onStack[w] = true;
+               callStack.push_back(w);
+               callEdge.push_back(firstEdge[w]);
+            }
+            else if(onStack[w])
+               low[v] = getMin(low[v], index[w]);
+            continue;
+         }
+         callStack.pop_back();
+         callEdge.pop_back();
+         if(callStack.size())
+            low[callStack.last()] = getMin(low[callStack.last()], low[v]);
+         if(low[v] == index[v])
+         {
+            U32 w;
+            do {
+               w = stack.last();
+               stack.pop_back();
+               onStack[w] = false;
+               mComponent[w] = components;
+            } while(w != v);
+            components++;
+         }
+      }
+   }
+
+   // Islands, ignoring direction.
+   mIsland.setSize(components);
+   for(U32 i = 0; i < components; i++)
+      mIsland[i] = i;
+   for(U32 v = 0; v < count; v++)
+      if(mComponent[v] != NoComponent)
+         for(U32 e = firstEdge[v]; e < firstEdge[v + 1]; e++)
+            mIsland[findIsland(mIsland, mComponent[v])] = findIsland(mIsland, mComponent[edges[e]]);
+   for(U32 i = 0; i < components; i++)
+      mIsland[i] = findIsland(mIsland, i);
+
+   // Reachability between components, lowest first so that everything a
+   // component leads to is already known.
+   mReach.clear();
+   mReachWords = 0;
+   if(components > MaxReachComponents)
+      return;
+   mReachWords = (components + 31) / 32;
+   mReach.setSize(components * mReachWords);
+   dMemset(mReach.address(), 0, mReach.size() * sizeof(U32));
+   Vector<Vector<U32> > members;
+   members.setSize(components);
+   for(U32 v = 0; v < count; v++)
+      if(mComponent[v] != NoComponent)
+         members[mComponent[v]].push_back(v);
+   for(U32 c = 0; c < components; c++)
+   {
+      U32 *row = &mReach[c * mReachWords];
+      row[c / 32] |= 1 << (c % 32);
+      for(U32 m = 0; m < members[c].size(); m++)
+      {
+         const U32 v = members[c][m];
+         for(U32 e = firstEdge[v]; e < firstEdge[v + 1]; e++)
+         {
+            const U32 d = mComponent[edges[e]];
+            if(d == c)
+               continue;
+            const U32 *other = &mReach[d * mReachWords];
+            for(U32 w = 0; w < mReachWords; w++)
+               row[w] |= other[w];
+         }
+      }
+   }
+}
+
+bool NavMeshConnectivity::canReach(const dtNavMesh *nm, dtPolyRef from, dtPolyRef to) const
+{
+   U32 a, b;
+   if(!getIndex(nm, from, a) || !getIndex(nm, to, b))
+      return true;
+   const U32 ca = mComponent[a], cb = mComponent[b];
+   // Let the search decide what to do with polygons the filter refuses.
+   if(ca == NoComponent || cb == NoComponent)
+      return true;
+   if(mIsland[ca] != mIsland[cb])
+      return false;
+   if(!mReachWords)
+      return true;
+   return (mReach[ca * mReachWords + cb / 32] & (1 << (cb % 32))) != 0;
+}
@@ -0,0 +1,80 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2014 Daniel Buckmaster
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef _NAVCONNECTIVITY_H_
+#define _NAVCONNECTIVITY_H_
+
+#include "core/util/tVector.h"
+
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+
+/// @class NavMeshConnectivity
+/// Which polygons of a dtNavMesh can reach which others under a given
+/// filter, so that requests for impossible paths can be refused without
+/// searching. Polygons are labelled with their strongly connected
+/// component, so one-way off-mesh links are respected, and reachability
+/// between components is stored as a bit table when there are few enough
+/// of them. Otherwise only the undirected component is compared, which
+/// still refuses paths between separate islands.
+class NavMeshConnectivity {
+public:
+   NavMeshConnectivity();
+
+   /// Label every polygon of a mesh.
+   void build(const dtNavMesh *nm, const dtQueryFilter &filter);
+
+   /// Could there be a path from one polygon to another?
+   /// @return True unless there definitely isn't.
+   bool canReach(const dtNavMesh *nm, dtPolyRef from, dtPolyRef to) const;
+
+   /// Largest number of components to store reachability between.
+   static const U32 MaxReachComponents = 2048;
+
+   /// Filter flags we were built for.
+   U16 includeFlags, excludeFlags;
+   /// NavMesh versions we were built for.
+   U32 meshVersion, tileVersion;
+
+private:
+   /// Index of each tile's first polygon in our arrays, by tile index.
+   Vector<U32> mTileBase;
+   /// Salt of each tile when we were built.
+   Vector<U32> mTileSalt;
+
+   /// Strongly connected component of each polygon, or NoComponent if it
+   /// doesn't pass the filter.
+   Vector<U32> mComponent;
+   /// Undirected component of each strongly connected one.
+   Vector<U32> mIsland;
+   /// Rows of bits: which components each component can reach.
+   Vector<U32> mReach;
+   U32 mReachWords;
+
+   static const U32 NoComponent = 0xffffffff;
+
+   /// Find our index for a polygon.
+   /// @return False if the polygon's tile has changed since we were built.
+   bool getIndex(const dtNavMesh *nm, dtPolyRef ref, U32 &idx) const;
+};
+
+#endif
@@ -0,0 +1,569 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2014 Daniel Buckmaster
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "navFlowField.h"
+
+#include "console/consoleTypes.h"
+#include "console/engineAPI.h"
+
+IMPLEMENT_CONOBJECT(NavFlowField);
+
+ConsoleDocClass(NavFlowField,
+   "@brief Directions from anywhere on a NavMesh to a single goal.\n\n"
+   "Use a NavFlowField when many characters are heading to the same place, "
+   "such as a rally point. It is searched once for all of them, instead of "
+   "once per character, and kept up to date as the NavMesh changes.\n\n"
+   "@see AIPlayer::followFlowField\n\n"
+);
+
+NavFlowField::NavFlowField()
+{
+   mMesh = NULL;
+   mGoal.set(0, 0, 0);
+   mLinkTypes = LinkData(AllFlags);
+   mGoalRef = 0;
+   mMeshVersion = mTileVersion = 0;
+   mDirty = true;
+}
+
+NavFlowField::~NavFlowField()
+{
+}
+
+void NavFlowField::initPersistFields()
+{
+   addGroup("NavFlowField");
+
+   addProtectedField("mesh", TypeRealString, Offset(mMeshName, NavFlowField),
+      &setProtectedMesh, &defaultProtectedGetFn,
+      "NavMesh this field covers.");
+   addField("goal", TypePoint3F, Offset(mGoal, NavFlowField),
+      "World location characters following this field are directed to.");
+
+   endGroup("NavFlowField");
+
+   addGroup("Flags");
+
+   addField("allowWalk", TypeBool, Offset(mLinkTypes.walk, NavFlowField),
+      "Allow the field to use dry land.");
+   addField("allowJump", TypeBool, Offset(mLinkTypes.jump, NavFlowField),
+      "Allow the field to use jump links.");
+   addField("allowDrop", TypeBool, Offset(mLinkTypes.drop, NavFlowField),
+      "Allow the field to use drop links.");
+   addField("allowSwim", TypeBool, Offset(mLinkTypes.swim, NavFlowField),
+      "Allow the field to move in water.");
+   addField("allowLedge", TypeBool, Offset(mLinkTypes.ledge, NavFlowField),
+      "Allow the field to jump ledges.");
+   addField("allowClimb", TypeBool, Offset(mLinkTypes.climb, NavFlowField),
+      "Allow the field to use climb links.");
+   addField("allowTeleport", TypeBool, Offset(mLinkTypes.teleport, NavFlowField),
+      "Allow the field to use teleporters.");
+
+   endGroup("Flags");
+
+   Parent::initPersistFields();
+}
+
+bool NavFlowField::setProtectedMesh(void *obj, const char *index, const char *data)
+{
+   NavFlowField *object = static_cast<NavFlowField*>(obj);
+   NavMesh *mesh;
+   if(Sim::findObject(data, mesh))
+   {
+      object->mMesh = mesh;
+      object->mDirty = true;
+   }
+   return true;
+}
+
+bool NavFlowField::onAdd()
+{
+   if(!Parent::onAdd())
+      return false;
+   mDirty = true;
+   return true;
+}
+
+void NavFlowField::onRemove()
+{
+   mTiles.clear();
+   Parent::onRemove();
+}
+
+void NavFlowField::inspectPostApply()
+{
+   // Goal or flags may have changed.
+   mDirty = true;
+}
+
+//-----------------------------------------------------------------------------
+// Searching
+//-----------------------------------------------------------------------------
+
+/// A tile vertex, in Recast space.
+static inline Point3F tileVert(const dtMeshTile *tile, U16 v)
+{
+   const F32 *p = &tile->verts[v * 3];
+   return Point3F(p[0], p[1], p[2]);
+}
+
+/// Average of a polygon's vertices, in Recast space.
+static Point3F polyCentroid(const dtMeshTile *tile, const dtPoly *poly)
+{
+   Point3F c(0, 0, 0);
+   for(U32 i = 0; i < poly->vertCount; i++)
+      c += tileVert(tile, poly->verts[i]);
+   return c / (F32)poly->vertCount;
+}
+
+/// The point to head for when moving from polygon a into b through link l.
+static Point3F portalPoint(const dtMeshTile *atile, const dtPoly *apoly, const dtLink &l,
+                           const dtMeshTile *btile, const dtPoly *bpoly)
+{
+   // Links onto an off-mesh connection have no edge; head for the nearest
+   // end of the connection.
+   if(l.edge == 0xff)
+   {
+      const Point3F c = polyCentroid(atile, apoly);
+      const Point3F v0 = tileVert(btile, bpoly->verts[0]);
+      const Point3F v1 = tileVert(btile, bpoly->verts[1]);
+      return RCtoDTS((v0 - c).lenSquared() < (v1 - c).lenSquared() ? v0 : v1);
+   }
+   // Off-mesh connections land at the vertex matching the link's edge.
+   if(apoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+      return RCtoDTS(tileVert(atile, apoly->verts[l.edge]));
+
+   const Point3F v0 = tileVert(atile, apoly->verts[l.edge]);
+   const Point3F v1 = tileVert(atile, apoly->verts[(l.edge + 1) % apoly->vertCount]);
+   // Links across tile borders may only cover part of the edge.
+   if(l.side != 0xff && (l.bmin != 0 || l.bmax != 255))
+   {
+      const F32 s = 1.0f / 255.0f;
+      Point3F left, right;
+      left.interpolate(v0, v1, l.bmin * s);
+      right.interpolate(v0, v1, l.bmax * s);
+      return RCtoDTS((left + right) * 0.5f);
+   }
+   return RCtoDTS((v0 + v1) * 0.5f);
+}
+
+void NavFlowField::resetTile(U32 i, const dtMeshTile *tile)
+{
+   TileField &f = mTiles[i];
+   const U32 polys = tile && tile->header ? tile->header->polyCount : 0;
+   f.salt = tile && tile->header ? tile->salt : 0;
+   if(tile && tile->header)
+   {
+      f.x = tile->header->x;
+      f.y = tile->header->y;
+      f.placed = true;
+   }
+   f.cost.setSize(polys);
+   f.next.setSize(polys);
+   f.portal.setSize(polys);
+   for(U32 j = 0; j < polys; j++)
+   {
+      f.cost[j] = F32_MAX;
+      f.next[j] = 0;
+   }
+   f.firstIn.setSize(polys + 1);
+   dMemset(f.firstIn.address(), 0, f.firstIn.memSize());
+   f.in.clear();
+}
+
+/// Most tiles we expect to share a grid cell, one per layer.
+static const S32 MaxTileLayers = 32;
+
+void NavFlowField::getNeighbours(U32 i, Vector<U32> &tiles) const
+{
+   const TileField &f = mTiles[i];
+   if(!f.placed)
+      return;
+   const dtNavMesh *nm = mMesh->getNavMesh();
+   const dtMeshTile *found[MaxTileLayers];
+   for(S32 dy = -1; dy <= 1; dy++)
+   {
+      for(S32 dx = -1; dx <= 1; dx++)
+      {
+         const S32 n = nm->getTilesAt(f.x + dx, f.y + dy, found, MaxTileLayers);
+         for(S32 k = 0; k < n; k++)
+            tiles.push_back(nm->decodePolyIdTile(nm->getTileRef(found[k])));
+      }
+   }
+}
+
+void NavFlowField::linkTile(U32 i)
+{
+   TileField &f = mTiles[i];
+   const U32 polys = f.cost.size();
+   f.firstIn.setSize(polys + 1);
+   dMemset(f.firstIn.address(), 0, f.firstIn.memSize());
+   f.in.clear();
+   if(!polys)
+      return;
+
+   const dtNavMesh *nm = mMesh->getNavMesh();
+   Vector<U32> sources;
+   getNeighbours(i, sources);
+
+   // Count the links into each polygon, then fill them in, as the
+   // landmark graph does.
+   Vector<U32> fill;
+   for(U32 pass = 0; pass < 2; pass++)
+   {
+      for(U32 s = 0; s < sources.size(); s++)
+      {
+         const dtMeshTile *tile = nm->getTile(sources[s]);
+         const dtPolyRef base = nm->getPolyRefBase(tile);
+         for(U32 j = 0; j < tile->header->polyCount; j++)
+         {
+            const dtPoly *poly = &tile->polys[j];
+            for(U32 l = poly->firstLink; l != DT_NULL_LINK; l = tile->links[l].next)
+            {
+               U32 salt, it, ip;
+               nm->decodePolyId(tile->links[l].ref, salt, it, ip);
+               if(it != i || salt != f.salt || ip >= polys)
+                  continue;
+               if(pass == 0)
+                  f.firstIn[ip + 1]++;
+               else
+                  f.in[fill[ip]++] = base | (dtPolyRef)j;
+            }
+         }
+      }
+      if(pass == 0)
+      {
+         for(U32 j = 0; j < polys; j++)
+            f.firstIn[j + 1] += f.firstIn[j];
+         f.in.setSize(f.firstIn[polys]);
+         fill = f.firstIn;
+      }
+   }
+}
+
+bool NavFlowField::getEntry(dtPolyRef ref, TileField *&field, U32 &idx)
+{
+   const dtNavMesh *nm = mMesh->getNavMesh();
+   U32 salt, it, ip;
+   nm->decodePolyId(ref, salt, it, ip);
+   if(it >= mTiles.size() || mTiles[it].salt != salt || ip >= mTiles[it].cost.size())
+      return false;
+   field = &mTiles[it];
+   idx = ip;
+   return true;
+}
+
+dtPolyRef NavFlowField::findPoly(const Point3F &pos)
+{
+   if(mMesh.isNull() || !mMesh->getNavMesh())
+      return 0;
+   dtNavMeshQuery *query = mMesh->acquireQuery();
+   if(!query)
+      return 0;
+   const Point3F p = DTStoRC(pos);
+   const F32 extents[] = {mMesh->mWalkableRadius * 4.0f, mMesh->mWalkableHeight, mMesh->mWalkableRadius * 4.0f};
+   dtPolyRef ref = 0;
+   query->findNearestPoly(p, extents, &mFilter, &ref, NULL);
+   mMesh->releaseQuery(query);
+   return ref;
+}
+
+bool NavFlowField::build()
+{
+   mDirty = false;
+   mTiles.clear();
+   mGoalRef = 0;
+   if(mMesh.isNull() || !mMesh->getNavMesh())
+      return false;
+
+   PROFILE_SCOPE(NavFlowField_build);
+
+   const dtNavMesh *nm = mMesh->getNavMesh();
+   mMeshVersion = mMesh->getMeshVersion();
+   mTileVersion = mMesh->getTileVersion();
+   mFilter.setIncludeFlags(mLinkTypes.getFlags());
+
+   mTiles.setSize(nm->getMaxTiles());
+   for(U32 i = 0; i < mTiles.size(); i++)
+      resetTile(i, nm->getTile(i));
+   for(U32 i = 0; i < mTiles.size(); i++)
+      linkTile(i);
+
+   mGoalRef = findPoly(mGoal);
+   TileField *f;
+   U32 idx;
+   if(!mGoalRef || !getEntry(mGoalRef, f, idx))
+   {
+      Con::errorf("NavFlowField %s: no NavMesh polygon near goal (%g, %g, %g)",
+         getIdString(), mGoal.x, mGoal.y, mGoal.z);
+      mGoalRef = 0;
+      return false;
+   }
+   f->cost[idx] = 0.0f;
+   f->next[idx] = 0;
+   f->portal[idx] = mGoal;
+
+   OpenList open;
+   OpenNode start = {0.0f, mGoalRef};
+   open.push(start);
+   search(open);
+   return true;
+}
+
+void NavFlowField::repair()
+{
+   PROFILE_SCOPE(NavFlowField_repair);
+
+   const dtNavMesh *nm = mMesh->getNavMesh();
+   mTileVersion = mMesh->getTileVersion();
+
+   // Forget rebuilt tiles.
+   Vector<U32> rebuilt;
+   for(U32 i = 0; i < mTiles.size(); i++)
+   {
+      const dtMeshTile *tile = nm->getTile(i);
+      const U32 salt = tile && tile->header ? tile->salt : 0;
+      if(mTiles[i].salt != salt)
+      {
+         resetTile(i, tile);
+         rebuilt.push_back(i);
+      }
+   }
+   if(!rebuilt.size())
+      return;
+
+   // The goal itself was rebuilt, so nothing is worth keeping.
+   TileField *f;
+   U32 idx;
+   if(!getEntry(mGoalRef, f, idx) || f->cost[idx] != 0.0f)
+   {
+      build();
+      return;
+   }
+
+   // Links into rebuilt tiles, and out of them into their neighbours, have
+   // all changed.
+   Vector<U32> near;
+   for(U32 i = 0; i < rebuilt.size(); i++)
+      getNeighbours(rebuilt[i], near);
+   Vector<bool> relinked;
+   relinked.setSize(mTiles.size());
+   relinked.fill(false);
+   for(U32 i = 0; i < rebuilt.size(); i++)
+   {
+      relinked[rebuilt[i]] = true;
+      linkTile(rebuilt[i]);
+   }
+   for(U32 i = 0; i < near.size(); i++)
+   {
+      if(relinked[near[i]])
+         continue;
+      relinked[near[i]] = true;
+      linkTile(near[i]);
+   }
+
+   // Unlink polygons that moved straight into a rebuilt tile. Only the
+   // rebuilt tiles' neighbours can hold them.
+   Vector<dtPolyRef> lost;
+   for(U32 i = 0; i < near.size(); i++)
+   {
+      TileField &t = mTiles[near[i]];
+      for(U32 j = 0; j < t.cost.size(); j++)
+      {
+         TileField *nf;
+         U32 nidx;
+         if(t.cost[j] == F32_MAX || !t.next[j])
+            continue;
+         if(getEntry(t.next[j], nf, nidx) && nf->cost[nidx] != F32_MAX)
+            continue;
+         t.cost[j] = F32_MAX;
+         t.next[j] = 0;
+         lost.push_back(nm->encodePolyId(t.salt, near[i], j));
+      }
+   }
+   // Then everything routed through those, following the field backwards.
+   for(U32 i = 0; i < lost.size(); i++)
+   {
+      getEntry(lost[i], f, idx);
+      for(U32 k = f->firstIn[idx]; k < f->firstIn[idx + 1]; k++)
+      {
+         TileField *bf;
+         U32 bidx;
+         if(!getEntry(f->in[k], bf, bidx) || bf->next[bidx] != lost[i])
+            continue;
+         bf->cost[bidx] = F32_MAX;
+         bf->next[bidx] = 0;
+         lost.push_back(f->in[k]);
+      }
+   }
+
+   // Search again from every reached polygon an unreached one can move
+   // into. Costs reached polygons can now beat are lowered as it passes.
+   for(U32 i = 0; i < rebuilt.size(); i++)
+   {
+      const dtMeshTile *tile = nm->getTile(rebuilt[i]);
+      if(!tile || !tile->header)
+         continue;
+      const dtPolyRef base = nm->getPolyRefBase(tile);
+      for(U32 j = 0; j < tile->header->polyCount; j++)
+         lost.push_back(base | (dtPolyRef)j);
+   }
+   OpenList open;
+   for(U32 i = 0; i < lost.size(); i++)
+   {
+      const dtMeshTile *tile;
+      const dtPoly *poly;
+      nm->getTileAndPolyByRefUnsafe(lost[i], &tile, &poly);
+      for(U32 l = poly->firstLink; l != DT_NULL_LINK; l = tile->links[l].next)
+      {
+         TileField *nf;
+         U32 nidx;
+         const dtPolyRef ref = tile->links[l].ref;
+         if(!ref || !getEntry(ref, nf, nidx) || nf->cost[nidx] == F32_MAX)
+            continue;
+         OpenNode n = {nf->cost[nidx], ref};
+         open.push(n);
+      }
+   }
+   search(open);
+}
+
+void NavFlowField::search(OpenList &open)
+{
+   const dtNavMesh *nm = mMesh->getNavMesh();
+   while(!open.empty())
+   {
+      const OpenNode n = open.top();
+      open.pop();
+
+      TileField *af;
+      U32 aidx;
+      if(!getEntry(n.ref, af, aidx) || n.cost > af->cost[aidx])
+         continue;
+      const dtMeshTile *atile;
+      const dtPoly *apoly;
+      nm->getTileAndPolyByRefUnsafe(n.ref, &atile, &apoly);
+      const Point3F acentre = polyCentroid(atile, apoly);
+
+      // We search backwards, so look at neighbours that can move into us,
+      // including the starts of one-way links.
+      for(U32 k = af->firstIn[aidx]; k < af->firstIn[aidx + 1]; k++)
+      {
+         const dtPolyRef bref = af->in[k];
+         TileField *bf;
+         U32 bidx;
+         if(!getEntry(bref, bf, bidx))
+            continue;
+         const dtMeshTile *btile;
+         const dtPoly *bpoly;
+         nm->getTileAndPolyByRefUnsafe(bref, &btile, &bpoly);
+         if(!mFilter.passFilter(bref, btile, bpoly))
+            continue;
+
+         // The step is priced and placed by the link it takes.
+         const dtLink *link = NULL;
+         for(U32 l = bpoly->firstLink; l != DT_NULL_LINK; l = btile->links[l].next)
+         {
+            if(btile->links[l].ref == n.ref)
+            {
+               link = &btile->links[l];
+               break;
+            }
+         }
+         if(!link)
+            continue;
+
+         const F32 cost = af->cost[aidx] +
+            (polyCentroid(btile, bpoly) - acentre).len() * mFilter.getAreaCost(bpoly->getArea());
+         if(cost >= bf->cost[bidx])
+            continue;
+
+         bf->cost[bidx] = cost;
+         bf->next[bidx] = n.ref;
+         bf->portal[bidx] = portalPoint(btile, bpoly, *link, atile, apoly);
+         OpenNode m = {cost, bref};
+         open.push(m);
+      }
+   }
+}
+
+bool NavFlowField::update()
+{
+   if(mMesh.isNull() || !mMesh->getNavMesh())
+      return false;
+   if(mDirty || mMeshVersion != mMesh->getMeshVersion())
+      return build();
+   if(mTileVersion != mMesh->getTileVersion())
+      repair();
+   return mGoalRef != 0;
+}
+
+//-----------------------------------------------------------------------------
+// Lookups
+//-----------------------------------------------------------------------------
+
+bool NavFlowField::getNext(dtPolyRef poly, dtPolyRef &next, Point3F &point)
+{
+   TileField *f;
+   U32 idx;
+   if(!update() || !getEntry(poly, f, idx) || f->cost[idx] == F32_MAX)
+      return false;
+   next = f->next[idx];
+   point = f->portal[idx];
+   return true;
+}
+
+F32 NavFlowField::getCost(dtPolyRef poly)
+{
+   TileField *f;
+   U32 idx;
+   if(!update() || !getEntry(poly, f, idx) || f->cost[idx] == F32_MAX)
+      return -1.0f;
+   return f->cost[idx];
+}
+
+DefineEngineMethod(NavFlowField, build, bool, (),,
+   "@brief Search the whole NavMesh again.\n\n"
+   "This happens automatically when the field is first used, or its goal, mesh "
+   "or flags are changed.\n\n"
+   "@return False if the goal isn't on the NavMesh.")
+{
+   return object->build();
+}
+
+DefineEngineMethod(NavFlowField, getNextPoint, Point3F, (Point3F pos),,
+   "@brief Get the point a character at the given position should head for.\n\n"
+   "@return The position itself if the goal can't be reached from there.")
+{
+   dtPolyRef next;
+   Point3F point;
+   if(object->getNext(object->findPoly(pos), next, point))
+      return point;
+   return pos;
+}
+
+DefineEngineMethod(NavFlowField, getCost, F32, (Point3F pos),,
+   "@brief Get the cost of moving from a position to the goal.\n\n"
+   "@return -1 if the goal can't be reached from there.")
+{
+   return object->getCost(object->findPoly(pos));
+}
@@ -0,0 +1,170 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2014 Daniel Buckmaster
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef _NAVFLOWFIELD_H_
+#define _NAVFLOWFIELD_H_
+
+#include <queue>
+
+#include "navMesh.h"
+#include "torqueRecast.h"
+
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+
+/// @class NavFlowField
+/// Directions from every polygon of a NavMesh to a single goal, for use by
+/// many characters heading to the same place. The field is built with one
+/// reverse Dijkstra search out from the goal polygon, after which finding
+/// where to head next from any polygon is a table lookup. When tiles of
+/// the NavMesh are rebuilt, only the part of the field that was routed
+/// through them is searched again.
+/// @see NavMesh
+class NavFlowField : public SimObject {
+   typedef SimObject Parent;
+
+public:
+   NavFlowField();
+   ~NavFlowField();
+
+   DECLARE_CONOBJECT(NavFlowField);
+
+   /// @name NavFlowField
+   /// @{
+
+   String mMeshName;
+   /// Mesh the field covers.
+   SimObjectPtr<NavMesh> mMesh;
+
+   /// World position characters are directed to.
+   Point3F mGoal;
+
+   /// What sort of link types are we allowed to move on?
+   LinkData mLinkTypes;
+
+   /// Search the whole mesh again.
+   /// @return False if the goal isn't on the mesh.
+   bool build();
+
+   /// Find where to go from a polygon. Brings the field up to date first.
+   /// @param poly  Polygon to move from.
+   /// @param next  Set to the polygon to move into, or 0 at the goal.
+   /// @param point Set to the point to head for: the portal into next, or
+   ///              the goal itself.
+   /// @return False if the goal can't be reached from poly.
+   bool getNext(dtPolyRef poly, dtPolyRef &next, Point3F &point);
+
+   /// Find the polygon nearest a world position.
+   dtPolyRef findPoly(const Point3F &pos);
+
+   /// Get the cost of moving from a polygon to the goal.
+   /// @return -1 if the goal can't be reached.
+   F32 getCost(dtPolyRef poly);
+
+   /// @}
+
+   /// @name SimObject
+   /// @{
+
+   static void initPersistFields();
+
+   bool onAdd();
+   void onRemove();
+
+   void inspectPostApply();
+
+   /// @}
+
+private:
+   /// Field data for the polygons of one dtNavMesh tile.
+   struct TileField {
+      /// Salt of the tile when we last searched it.
+      U32 salt;
+      /// Location of the tile, kept after it is removed so we can still
+      /// find its neighbours.
+      S32 x, y;
+      bool placed;
+      /// Cost to the goal of each polygon, or F32_MAX if unreached.
+      Vector<F32> cost;
+      /// Polygon to move into from each polygon.
+      Vector<dtPolyRef> next;
+      /// Point to head for from each polygon.
+      Vector<Point3F> portal;
+      /// Polygons with a link into each of ours. Those of polygon j are
+      /// in[firstIn[j]] up to in[firstIn[j+1]].
+      Vector<U32> firstIn;
+      Vector<dtPolyRef> in;
+      TileField() : salt(0), x(0), y(0), placed(false) {}
+   };
+
+   /// Fields indexed by dtNavMesh tile index.
+   Vector<TileField> mTiles;
+
+   dtQueryFilter mFilter;
+   dtPolyRef mGoalRef;
+
+   /// Mesh versions the field was last brought up to date with.
+   U32 mMeshVersion;
+   U32 mTileVersion;
+
+   /// Does the field need to be built from scratch?
+   bool mDirty;
+
+   /// Rebuild or repair the field if the mesh has changed.
+   bool update();
+
+   /// Search again from around the parts of the field that were routed
+   /// through tiles that have been rebuilt.
+   void repair();
+
+   /// Make a tile's field match the tile's polygons, all unreached.
+   void resetTile(U32 i, const dtMeshTile *tile);
+
+   /// Find the links into a tile's polygons. Links only come from a tile
+   /// and its neighbours, so those must be relinked when it changes.
+   void linkTile(U32 i);
+
+   /// Add the indices of a tile and the tiles around it to a list.
+   void getNeighbours(U32 i, Vector<U32> &tiles) const;
+
+   /// Find the field entry of a polygon.
+   /// @return False if the polygon no longer exists.
+   bool getEntry(dtPolyRef ref, TileField *&field, U32 &idx);
+
+public:
+   /// A polygon waiting to be expanded, and its cost when it was queued.
+   struct OpenNode {
+      F32 cost;
+      dtPolyRef ref;
+      bool operator<(const OpenNode &o) const { return cost > o.cost; }
+   };
+   typedef std::priority_queue<OpenNode> OpenList;
+
+private:
+   /// Run the search until every reachable polygon has its lowest cost.
+   void search(OpenList &open);
+
+   /// Function used to set mMesh object from console.
+   static bool setProtectedMesh(void *obj, const char *index, const char *data);
+};
+
+#endif
@@ -0,0 +1,471 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2014 Daniel Buckmaster
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "navHierarchy.h"
+#include "torqueRecast.h"
+
+#include "platform/profiler.h"
+
+#include <queue>
+
+/// Average of a polygon's vertices, in Recast space.
+static Point3F polyCentroid(const dtMeshTile *tile, const dtPoly *poly)
+{
+   Point3F c(0, 0, 0);
+   for(U32 i = 0; i < poly->vertCount; i++)
+   {
+      const F32 *v = &tile->verts[poly->verts[i] * 3];
+      c += Point3F(v[0], v[1], v[2]);
+   }
+   return c / (F32)poly->vertCount;
+}
+
+static S32 findRoot(Vector<S32> &sets, S32 i)
+{
+   while(sets[i] != i)
+   {
+      sets[i] = sets[sets[i]];
+      i = sets[i];
+   }
+   return i;
+}
+
+NavMeshHierarchy::NavMeshHierarchy()
+{
+   mRebuild = true;
+}
+
+void NavMeshHierarchy::clear()
+{
+   mNodes.clear();
+   mFreeNodes.clear();
+   mTileNodes.clear();
+   mDirtyTiles.clear();
+   mRebuild = true;
+}
+
+void NavMeshHierarchy::markTile(S32 x, S32 y)
+{
+   if(mRebuild)
+      return;
+   // Neighbouring tiles have entrances facing this one, so redo them too.
+   for(S32 dx = -1; dx <= 1; dx++)
+   {
+      for(S32 dy = -1; dy <= 1; dy++)
+      {
+         const U32 key = tileKey(x + dx, y + dy);
+         if(!mDirtyTiles.contains(key))
+            mDirtyTiles.push_back(key);
+      }
+   }
+}
+
+bool NavMeshHierarchy::update(const dtNavMesh *nm, dtNavMeshQuery *query, U32 maxTiles)
+{
+   if(mRebuild)
+   {
+      clear();
+      mRebuild = false;
+      for(S32 i = 0; i < nm->getMaxTiles(); i++)
+      {
+         const dtMeshTile *tile = nm->getTile(i);
+         if(tile && tile->header && !tile->header->layer)
+            mDirtyTiles.push_back(tileKey(tile->header->x, tile->header->y));
+      }
+   }
+
+   PROFILE_SCOPE(NavMeshHierarchy_update);
+
+   // Each tile is redone on its own, so the graph can catch up a few
+   // tiles at a time.
+   for(U32 i = 0; i < maxTiles && mDirtyTiles.size(); i++)
+   {
+      const U32 key = mDirtyTiles.front();
+      mDirtyTiles.pop_front();
+      removeTileNodes(key);
+      addTileNodes(nm, key);
+      addTileEdges(nm, query, key);
+   }
+
+   return isReady();
+}
+
+void NavMeshHierarchy::removeTileNodes(U32 key)
+{
+   Map<U32, Vector<U32> >::Iterator it = mTileNodes.find(key);
+   if(it == mTileNodes.end())
+      return;
+
+   // Only nodes in neighbouring tiles have edges to ours.
+   for(S32 dx = -1; dx <= 1; dx++)
+   {
+      for(S32 dy = -1; dy <= 1; dy++)
+      {
+         Map<U32, Vector<U32> >::Iterator nit = mTileNodes.find(tileKey(keyX(key) + dx, keyY(key) + dy));
+         if((!dx && !dy) || nit == mTileNodes.end())
+            continue;
+         for(U32 i = 0; i < nit->value.size(); i++)
+         {
+            Vector<Edge> &edges = mNodes[nit->value[i]].edges;
+            for(U32 j = 0; j < edges.size();)
+            {
+               if(mNodes[edges[j].to].tile == key)
+                  edges.erase_fast(j);
+               else
+                  j++;
+            }
+         }
+      }
+   }
+
+   for(U32 i = 0; i < it->value.size(); i++)
+   {
+      Node &n = mNodes[it->value[i]];
+      n.poly = 0;
+      n.members.clear();
+      n.edges.clear();
+      mFreeNodes.push_back(it->value[i]);
+   }
+   mTileNodes.erase(key);
+}
+
+void NavMeshHierarchy::addTileNodes(const dtNavMesh *nm, U32 key)
+{
+   const dtMeshTile *tile = nm->getTileAt(keyX(key), keyY(key), 0);
+   if(!tile || !tile->header)
+      return;
+
+   const dtPolyRef base = nm->getPolyRefBase(tile);
+   const U32 tileIdx = nm->decodePolyIdTile(base);
+   const S32 polyCount = tile->header->polyCount;
+   Vector<S32> sets;
+   sets.setSize(polyCount);
+   Vector<U32> nodes;
+
+   for(U32 side = 0; side < 8; side++)
+   {
+      // Polygons linked to the neighbour on this side.
+      for(S32 i = 0; i < polyCount; i++)
+      {
+         sets[i] = -1;
+         const dtPoly &poly = tile->polys[i];
+         for(U32 l = poly.firstLink; l != DT_NULL_LINK; l = tile->links[l].next)
+         {
+            if(tile->links[l].side == side)
+            {
+               sets[i] = i;
+               break;
+            }
+         }
+      }
+
+      // Join those that are linked to each other.
+      for(S32 i = 0; i < polyCount; i++)
+      {
+         if(sets[i] < 0)
+            continue;
+         const dtPoly &poly = tile->polys[i];
+         for(U32 l = poly.firstLink; l != DT_NULL_LINK; l = tile->links[l].next)
+         {
+            const dtLink &link = tile->links[l];
+            if(link.side != 0xff || nm->decodePolyIdTile(link.ref) != tileIdx)
+               continue;
+            const S32 j = nm->decodePolyIdPoly(link.ref);
+            if(j < polyCount && sets[j] >= 0)
+               sets[findRoot(sets, i)] = findRoot(sets, j);
+         }
+      }
+
+      // Each set is an entrance.
+      for(S32 i = 0; i < polyCount; i++)
+      {
+         if(sets[i] < 0 || findRoot(sets, i) != i)
+            continue;
+         U32 idx;
+         if(mFreeNodes.size())
+         {
+            idx = mFreeNodes.last();
+            mFreeNodes.pop_back();
+         }
+         else
+         {
+            idx = mNodes.size();
+            mNodes.increment();
+         }
+         Node &n = mNodes[idx];
+         n.poly = base | i;
+         n.pos = polyCentroid(tile, &tile->polys[i]);
+         n.tile = key;
+         n.members.clear();
+         n.edges.clear();
+         for(S32 j = 0; j < polyCount; j++)
+            if(sets[j] >= 0 && findRoot(sets, j) == i)
+               n.members.push_back(base | j);
+         nodes.push_back(idx);
+      }
+   }
+
+   if(nodes.size())
+      mTileNodes.insert(key, nodes);
+}
+
+void NavMeshHierarchy::addTileEdges(const dtNavMesh *nm, dtNavMeshQuery *query, U32 key)
+{
+   Map<U32, Vector<U32> >::Iterator it = mTileNodes.find(key);
+   if(it == mTileNodes.end())
+      return;
+   const Vector<U32> &nodes = it->value;
+
+   // Edges are costed for anyone; planning skips those a filter can't use.
+   dtQueryFilter filter;
+   dtPolyRef path[MaxSegmentLen];
+   Vector<U16> flags;
+
+   // Between entrances of this tile.
+   for(U32 a = 0; a < nodes.size(); a++)
+   {
+      for(U32 b = 0; b < nodes.size(); b++)
+      {
+         if(a == b)
+            continue;
+         const Node &from = mNodes[nodes[a]];
+         const Node &to = mNodes[nodes[b]];
+         S32 pathLen = 0;
+         dtStatus status = query->findPath(from.poly, to.poly, from.pos, to.pos, &filter, path, &pathLen, MaxSegmentLen);
+         if(dtStatusFailed(status) || dtStatusDetail(status, DT_PARTIAL_RESULT) || !pathLen)
+            continue;
+         F32 cost = 0.0f;
+         flags.clear();
+         Point3F last = from.pos;
+         for(S32 i = 0; i < pathLen; i++)
+         {
+            const dtMeshTile *tile;
+            const dtPoly *poly;
+            nm->getTileAndPolyByRefUnsafe(path[i], &tile, &poly);
+            const Point3F c = polyCentroid(tile, poly);
+            cost += (c - last).len();
+            if(!flags.contains(poly->flags))
+               flags.push_back(poly->flags);
+            last = c;
+         }
+         cost += (to.pos - last).len();
+         addEdge(nodes[a], nodes[b], cost, flags);
+      }
+   }
+
+   // Across borders, both out of this tile and into it, since links
+   // into it from a neighbour may only go one way.
+   for(U32 a = 0; a < nodes.size(); a++)
+      addBorderEdges(nm, nodes[a]);
+   for(S32 dx = -1; dx <= 1; dx++)
+   {
+      for(S32 dy = -1; dy <= 1; dy++)
+      {
+         Map<U32, Vector<U32> >::Iterator nit = mTileNodes.find(tileKey(keyX(key) + dx, keyY(key) + dy));
+         if((!dx && !dy) || nit == mTileNodes.end())
+            continue;
+         for(U32 i = 0; i < nit->value.size(); i++)
+            addBorderEdges(nm, nit->value[i]);
+      }
+   }
+}
+
+void NavMeshHierarchy::addBorderEdges(const dtNavMesh *nm, U32 node)
+{
+   Vector<U16> flags;
+   for(U32 m = 0; m < mNodes[node].members.size(); m++)
+   {
+      const dtMeshTile *tile;
+      const dtPoly *poly;
+      nm->getTileAndPolyByRefUnsafe(mNodes[node].members[m], &tile, &poly);
+      for(U32 l = poly->firstLink; l != DT_NULL_LINK; l = tile->links[l].next)
+      {
+         const dtLink &link = tile->links[l];
+         if(link.side == 0xff)
+            continue;
+         const dtMeshTile *ntile;
+         const dtPoly *npoly;
+         nm->getTileAndPolyByRefUnsafe(link.ref, &ntile, &npoly);
+         const S32 b = findNode(tileKey(ntile->header->x, ntile->header->y), link.ref);
+         if(b < 0)
+            continue;
+         flags.clear();
+         flags.push_back(poly->flags);
+         if(npoly->flags != poly->flags)
+            flags.push_back(npoly->flags);
+         addEdge(node, b, (mNodes[b].pos - mNodes[node].pos).len(), flags);
+      }
+   }
+}
+
+S32 NavMeshHierarchy::findNode(U32 key, dtPolyRef poly) const
+{
+   Map<U32, Vector<U32> >::ConstIterator it = mTileNodes.find(key);
+   if(it == mTileNodes.end())
+      return -1;
+   for(U32 i = 0; i < it->value.size(); i++)
+      if(mNodes[it->value[i]].members.contains(poly))
+         return it->value[i];
+   return -1;
+}
+
+void NavMeshHierarchy::addEdge(U32 from, U32 to, F32 cost, const Vector<U16> &flags)
+{
+   Vector<Edge> &edges = mNodes[from].edges;
+   for(U32 i = 0; i < edges.size(); i++)
+      if(edges[i].to == to)
+         return;
+   edges.increment();
+   Edge &e = edges.last();
+   e.to = to;
+   e.cost = cost;
+   e.flags = flags;
+}
+
+bool NavMeshHierarchy::Edge::passFilter(U16 include, U16 exclude) const
+{
+   // The test dtQueryFilter makes of each polygon.
+   for(U32 i = 0; i < flags.size(); i++)
+      if(!(flags[i] & include) || (flags[i] & exclude))
+         return false;
+   return true;
+}
+
+//-----------------------------------------------------------------------------
+// Planning
+//-----------------------------------------------------------------------------
+
+/// State of an A* search over the graph, with two extra nodes for the
+/// start and goal positions.
+struct NavHierarchySearch
+{
+   struct OpenNode {
+      F32 total;
+      U32 idx;
+      bool operator<(const OpenNode &o) const { return total > o.total; }
+   };
+
+   Vector<F32> cost;
+   Vector<S32> parent;
+   Vector<Point3F> pos;
+   std::priority_queue<OpenNode> open;
+   Point3F goal;
+
+   void relax(U32 from, U32 to, F32 edgeCost)
+   {
+      const F32 c = cost[from] + edgeCost;
+      if(c >= cost[to])
+         return;
+      cost[to] = c;
+      parent[to] = from;
+      OpenNode n = {c + (pos[to] - goal).len(), to};
+      open.push(n);
+   }
+};
+
+bool NavMeshHierarchy::findRoute(const dtNavMesh *nm,
+                                 dtPolyRef startRef, dtPolyRef endRef,
+                                 const F32 *from, const F32 *to,
+                                 const dtQueryFilter &filter,
+                                 Vector<dtPolyRef> &refs, Vector<Point3F> &points) const
+{
+   PROFILE_SCOPE(NavMeshHierarchy_findRoute);
+
+   const dtMeshTile *stile, *etile;
+   const dtPoly *poly;
+   if(dtStatusFailed(nm->getTileAndPolyByRef(startRef, &stile, &poly)) ||
+      dtStatusFailed(nm->getTileAndPolyByRef(endRef, &etile, &poly)))
+      return false;
+   const U32 endKey = tileKey(etile->header->x, etile->header->y);
+   Map<U32, Vector<U32> >::ConstIterator startNodes = mTileNodes.find(tileKey(stile->header->x, stile->header->y));
+   if(startNodes == mTileNodes.end() || mTileNodes.find(endKey) == mTileNodes.end())
+      return false;
+
+   const U32 n = mNodes.size();
+   const U32 start = n, goal = n + 1;
+   NavHierarchySearch s;
+   s.goal.set(to[0], to[1], to[2]);
+   s.cost.setSize(n + 2);
+   s.parent.setSize(n + 2);
+   s.pos.setSize(n + 2);
+   for(U32 i = 0; i < n; i++)
+   {
+      s.cost[i] = F32_MAX;
+      s.parent[i] = -1;
+      s.pos[i] = mNodes[i].pos;
+   }
+   s.cost[goal] = F32_MAX;
+   s.parent[goal] = -1;
+   s.pos[goal] = s.goal;
+   s.cost[start] = 0.0f;
+   s.parent[start] = -1;
+   s.pos[start].set(from[0], from[1], from[2]);
+
+   const U16 include = filter.getIncludeFlags();
+   const U16 exclude = filter.getExcludeFlags();
+
+   NavHierarchySearch::OpenNode first = {(s.pos[start] - s.goal).len(), start};
+   s.open.push(first);
+   while(!s.open.empty())
+   {
+      const NavHierarchySearch::OpenNode top = s.open.top();
+      s.open.pop();
+      const U32 u = top.idx;
+      if(u == goal)
+         break;
+      // Already expanded at a lower cost.
+      if(top.total > s.cost[u] + (s.pos[u] - s.goal).len())
+         continue;
+
+      if(u == start)
+      {
+         for(U32 i = 0; i < startNodes->value.size(); i++)
+            s.relax(u, startNodes->value[i], (s.pos[startNodes->value[i]] - s.pos[start]).len());
+         continue;
+      }
+
+      const Node &node = mNodes[u];
+      for(U32 i = 0; i < node.edges.size(); i++)
+      {
+         const Edge &e = node.edges[i];
+         if(!e.passFilter(include, exclude))
+            continue;
+         s.relax(u, e.to, e.cost);
+      }
+      if(node.tile == endKey)
+         s.relax(u, goal, (s.goal - node.pos).len());
+   }
+   if(s.parent[goal] < 0)
+      return false;
+
+   refs.clear();
+   points.clear();
+   refs.push_back(endRef);
+   points.push_back(s.goal);
+   for(S32 i = s.parent[goal]; i != start; i = s.parent[i])
+   {
+      refs.push_front(mNodes[i].poly);
+      points.push_front(mNodes[i].pos);
+   }
+
+   return true;
+}
@@ -0,0 +1,137 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2014 Daniel Buckmaster
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef _NAVHIERARCHY_H_
+#define _NAVHIERARCHY_H_
+
+#include "math/mPoint3.h"
+#include "core/util/tVector.h"
+#include "core/util/tDictionary.h"
+
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+
+/// @class NavMeshHierarchy
+/// An abstract graph over the tiles of a dtNavMesh, used to plan paths
+/// too long for a single search. Each group of connected polygons along
+/// a tile border is an entrance node. Entrances in the same tile are
+/// joined by edges costed with a search inside the tile, and entrances
+/// facing each other across a border are joined directly. Paths are
+/// planned over this graph, then refined into a polygon corridor one
+/// short search at a time by whoever asked for them.
+/// @see NavMesh
+class NavMeshHierarchy {
+public:
+   NavMeshHierarchy();
+
+   /// Forget the whole graph, so every tile is rebuilt.
+   void clear();
+
+   /// Rebuild the part of the graph around a tile.
+   void markTile(S32 x, S32 y);
+
+   /// Rebuild some of the tiles that need it.
+   /// @param query Query attached to nm to cost edges with.
+   /// @param maxTiles Most tiles to rebuild in this call.
+   /// @return True if the whole graph is up to date.
+   bool update(const dtNavMesh *nm, dtNavMeshQuery *query, U32 maxTiles);
+
+   /// Is the whole graph up to date?
+   bool isReady() const { return !mRebuild && !mDirtyTiles.size(); }
+
+   /// Plan a route between two polygons through the graph, which must be
+   /// up to date. The route is a list of entrance polygons ending with
+   /// endRef, to be joined up by searches between each pair.
+   /// @param refs Polygons to pass through.
+   /// @param points Positions on those polygons, in Recast space.
+   /// @return False if no route was found.
+   bool findRoute(const dtNavMesh *nm,
+                  dtPolyRef startRef, dtPolyRef endRef,
+                  const F32 *from, const F32 *to,
+                  const dtQueryFilter &filter,
+                  Vector<dtPolyRef> &refs, Vector<Point3F> &points) const;
+
+   /// Number of entrance nodes in the graph.
+   U32 getNodeCount() const { return mNodes.size() - mFreeNodes.size(); }
+
+   /// Maximum polygons in each edge-costing search.
+   static const U32 MaxSegmentLen = 512;
+
+private:
+   struct Edge {
+      /// Index of the node this edge leads to.
+      U32 to;
+      F32 cost;
+      /// Each distinct set of flags among the polygons along the edge.
+      Vector<U16> flags;
+
+      /// Can a filter use every polygon along the edge?
+      bool passFilter(U16 include, U16 exclude) const;
+   };
+
+   struct Node {
+      /// Polygon the node stands for, in Recast space.
+      dtPolyRef poly;
+      Point3F pos;
+      /// Key of the tile the node is in.
+      U32 tile;
+      /// All the border polygons in this entrance.
+      Vector<dtPolyRef> members;
+      Vector<Edge> edges;
+   };
+
+   Vector<Node> mNodes;
+   /// Unused slots in mNodes.
+   Vector<U32> mFreeNodes;
+
+   /// Nodes in each tile, by tile key.
+   Map<U32, Vector<U32> > mTileNodes;
+
+   /// Tiles waiting to be rebuilt, by key, oldest first.
+   Vector<U32> mDirtyTiles;
+   /// Should the whole graph be rebuilt?
+   bool mRebuild;
+
+   static U32 tileKey(S32 x, S32 y) { return (x << 16) | (y & 0xffff); }
+   static S32 keyX(U32 key) { return (S16)(key >> 16); }
+   static S32 keyY(U32 key) { return (S16)(key & 0xffff); }
+
+   /// Remove all nodes of a tile, and all edges leading to them.
+   void removeTileNodes(U32 key);
+
+   /// Find the entrances of a tile.
+   void addTileNodes(const dtNavMesh *nm, U32 key);
+
+   /// Join a tile's entrances to each other and to neighbouring tiles.
+   void addTileEdges(const dtNavMesh *nm, dtNavMeshQuery *query, U32 key);
+
+   /// Join a node to the nodes its polygons link to in other tiles.
+   void addBorderEdges(const dtNavMesh *nm, U32 node);
+
+   /// Find the node in a tile that a polygon is part of.
+   S32 findNode(U32 key, dtPolyRef poly) const;
+
+   /// Add an edge unless there's one already.
+   void addEdge(U32 from, U32 to, F32 cost, const Vector<U16> &flags);
+};
+
+#endif
@@ -0,0 +1,358 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2014 Daniel Buckmaster
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "navLandmarks.h"
+
+#include "platform/profiler.h"
+
+#include <DetourCommon.h>
+#include <queue>
+
+NavMeshLandmarks::NavMeshLandmarks()
+{
+   meshVersion = tileVersion = 0;
+   mMesh = NULL;
+   mPolyCount = 0;
+}
+
+void NavMeshLandmarks::clear()
+{
+   mMesh = NULL;
+   mPolyCount = 0;
+   mTileBase.clear();
+   mTileSalt.clear();
+   mFirstIn.clear();
+   mPortals.clear();
+   mLandmarks.clear();
+   mCosts.clear();
+}
+
+bool NavMeshLandmarks::getIndex(dtPolyRef ref, U32 &idx) const
+{
+   U32 salt, it, ip;
+   mMesh->decodePolyId(ref, salt, it, ip);
+   if(it >= mTileSalt.size() || mTileSalt[it] != salt)
+      return false;
+   idx = mTileBase[it] + ip;
+   return idx < mPolyCount;
+}
+
+/// Midpoint of the portal from one polygon into another, worked out the
+/// same way as dtNavMeshQuery::getPortalPoints so it lands exactly where
+/// a search puts the node for the polygon entered.
+static bool portalMidpoint(dtPolyRef from, const dtMeshTile *fromTile, const dtPoly *fromPoly,
+                           const dtLink &link, const dtMeshTile *toTile, const dtPoly *toPoly,
+                           Point3F &mid)
+{
+   // Off-mesh connections are entered and left at their end points.
+   if(fromPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+   {
+      const F32 *v = &fromTile->verts[fromPoly->verts[link.edge] * 3];
+      mid.set(v[0], v[1], v[2]);
+      return true;
+   }
+   if(toPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+   {
+      for(U32 l = toPoly->firstLink; l != DT_NULL_LINK; l = toTile->links[l].next)
+      {
+         if(toTile->links[l].ref == from)
+         {
+            const F32 *v = &toTile->verts[toPoly->verts[toTile->links[l].edge] * 3];
+            mid.set(v[0], v[1], v[2]);
+            return true;
+         }
+      }
+      return false;
+   }
+
+   const F32 *v0 = &fromTile->verts[fromPoly->verts[link.edge] * 3];
+   const F32 *v1 = &fromTile->verts[fromPoly->verts[(link.edge + 1) % (S32)fromPoly->vertCount] * 3];
+   F32 left[3], right[3];
+   dtVcopy(left, v0);
+   dtVcopy(right, v1);
+   // Tile border portals only cover the part of the edge both tiles share.
+   if(link.side != 0xff && (link.bmin != 0 || link.bmax != 255))
+   {
+      const F32 s = 1.0f / 255.0f;
+      dtVlerp(left, v0, v1, link.bmin * s);
+      dtVlerp(right, v0, v1, link.bmax * s);
+   }
+   mid.set((left[0] + right[0]) * 0.5f, (left[1] + right[1]) * 0.5f, (left[2] + right[2]) * 0.5f);
+   return true;
+}
+
+/// Steps between portals as plain indices, in both directions.
+struct NavLandmarkGraph
+{
+   Vector<U32> firstEdge, edges;
+   Vector<U32> firstBack, back;
+   Vector<F32> edgeCost, backCost;
+
+   struct OpenNode {
+      F32 cost;
+      U32 idx;
+      bool operator<(const OpenNode &o) const { return cost > o.cost; }
+   };
+
+   /// Dijkstra's algorithm from one portal, writing costs with a stride.
+   void search(U32 from, bool reverse, F32 *costs, U32 stride, U32 count) const
+   {
+      const Vector<U32> &first = reverse ? firstBack : firstEdge;
+      const Vector<U32> &to = reverse ? back : edges;
+      const Vector<F32> &cost = reverse ? backCost : edgeCost;
+      for(U32 i = 0; i < count; i++)
+         costs[i * stride] = F32_MAX;
+      costs[from * stride] = 0.0f;
+      std::priority_queue<OpenNode> open;
+      OpenNode start = {0.0f, from};
+      open.push(start);
+      while(!open.empty())
+      {
+         const OpenNode top = open.top();
+         open.pop();
+         if(top.cost > costs[top.idx * stride])
+            continue;
+         for(U32 e = first[top.idx]; e < first[top.idx + 1]; e++)
+         {
+            const F32 c = top.cost + cost[e];
+            F32 &old = costs[to[e] * stride];
+            if(c >= old)
+               continue;
+            old = c;
+            OpenNode n = {c, to[e]};
+            open.push(n);
+         }
+      }
+   }
+};
+
+void NavMeshLandmarks::build(const dtNavMesh *nm, U32 count)
+{
+   PROFILE_SCOPE(NavMeshLandmarks_build);
+
+   clear();
+   mMesh = nm;
+
+   // Give every polygon an index.
+   const S32 maxTiles = nm->getMaxTiles();
+   mTileBase.setSize(maxTiles);
+   mTileSalt.setSize(maxTiles);
+   for(S32 i = 0; i < maxTiles; i++)
+   {
+      const dtMeshTile *tile = nm->getTile(i);
+      mTileBase[i] = mPolyCount;
+      mTileSalt[i] = tile && tile->header ? tile->salt : 0;
+      if(tile && tile->header)
+         mPolyCount += tile->header->polyCount;
+   }
+   if(!mPolyCount || !count)
+      return;
+
+   // Every link is a portal, in the order of the polygons it leads out of.
+   Vector<U32> firstOut, target;
+   Vector<Point3F> mids;
+   firstOut.setSize(mPolyCount + 1);
+   U32 p = 0;
+   for(S32 i = 0; i < maxTiles; i++)
+   {
+      const dtMeshTile *tile = nm->getTile(i);
+      if(!tile || !tile->header)
+         continue;
+      const dtPolyRef base = nm->getPolyRefBase(tile);
+      for(S32 j = 0; j < tile->header->polyCount; j++, p++)
+      {
+         firstOut[p] = target.size();
+         const dtPoly *poly = &tile->polys[j];
+         for(U32 l = poly->firstLink; l != DT_NULL_LINK; l = tile->links[l].next)
+         {
+            const dtLink &link = tile->links[l];
+            U32 idx;
+            if(!link.ref || !getIndex(link.ref, idx))
+               continue;
+            const dtMeshTile *ntile;
+            const dtPoly *npoly;
+            nm->getTileAndPolyByRefUnsafe(link.ref, &ntile, &npoly);
+            Point3F mid;
+            if(!portalMidpoint(base | (dtPolyRef)j, tile, poly, link, ntile, npoly, mid))
+               continue;
+            target.push_back(idx);
+            mids.push_back(mid);
+         }
+      }
+   }
+   firstOut[mPolyCount] = target.size();
+   const U32 portalCount = target.size();
+   if(!portalCount)
+      return;
+
+   // Group the portals by the polygon they lead into, which is how a
+   // search node finds its own.
+   mFirstIn.setSize(mPolyCount + 1);
+   dMemset(mFirstIn.address(), 0, mFirstIn.memSize());
+   for(U32 i = 0; i < portalCount; i++)
+      mFirstIn[target[i] + 1]++;
+   for(U32 i = 0; i < mPolyCount; i++)
+      mFirstIn[i + 1] += mFirstIn[i];
+   Vector<U32> slot, next;
+   slot.setSize(portalCount);
+   next.setSize(mPolyCount);
+   dMemcpy(next.address(), mFirstIn.address(), next.memSize());
+   mPortals.setSize(portalCount);
+   for(U32 i = 0; i < portalCount; i++)
+   {
+      slot[i] = next[target[i]]++;
+      mPortals[slot[i]] = mids[i];
+   }
+
+   // A search steps from the portal it entered a polygon by to each portal
+   // out of it, forwards, then turned around.
+   NavLandmarkGraph g;
+   g.firstEdge.setSize(portalCount + 1);
+   Vector<U32> incoming;
+   incoming.setSize(portalCount + 1);
+   dMemset(incoming.address(), 0, incoming.memSize());
+   for(U32 i = 0; i < mPolyCount; i++)
+   {
+      for(U32 v = mFirstIn[i]; v < mFirstIn[i + 1]; v++)
+      {
+         g.firstEdge[v] = g.edges.size();
+         for(U32 e = firstOut[i]; e < firstOut[i + 1]; e++)
+         {
+            const U32 w = slot[e];
+            g.edges.push_back(w);
+            g.edgeCost.push_back((mPortals[w] - mPortals[v]).len());
+            incoming[w]++;
+         }
+      }
+   }
+   g.firstEdge[portalCount] = g.edges.size();
+   g.firstBack.setSize(portalCount + 1);
+   g.back.setSize(g.edges.size());
+   g.backCost.setSize(g.edges.size());
+   U32 total = 0;
+   for(U32 i = 0; i <= portalCount; i++)
+   {
+      g.firstBack[i] = total;
+      total += incoming[i];
+      incoming[i] = g.firstBack[i];
+   }
+   for(U32 i = 0; i < portalCount; i++)
+   {
+      for(U32 e = g.firstEdge[i]; e < g.firstEdge[i + 1]; e++)
+      {
+         const U32 s = incoming[g.edges[e]]++;
+         g.back[s] = i;
+         g.backCost[s] = g.edgeCost[e];
+      }
+   }
+
+   // Place each landmark as far as possible from those before it, starting
+   // from the portal furthest from an arbitrary one.
+   count = getMin(count, portalCount);
+   const U32 stride = count * 2;
+   mCosts.setSize(portalCount * stride);
+   Vector<F32> nearest;
+   nearest.setSize(portalCount);
+   g.search(0, false, nearest.address(), 1, portalCount);
+   for(U32 k = 0; k < count; k++)
+   {
+      U32 next = 0;
+      F32 furthest = -1.0f;
+      for(U32 i = 0; i < portalCount; i++)
+      {
+         if(nearest[i] != F32_MAX && nearest[i] > furthest)
+         {
+            furthest = nearest[i];
+            next = i;
+         }
+      }
+      // Everything reachable is already a landmark.
+      if(furthest <= 0.0f && k)
+         break;
+      mLandmarks.push_back(next);
+      F32 *from = mCosts.address() + k;
+      F32 *to = mCosts.address() + count + k;
+      g.search(next, false, from, stride, portalCount);
+      g.search(next, true, to, stride, portalCount);
+      for(U32 i = 0; i < portalCount; i++)
+         nearest[i] = k ? getMin(nearest[i], from[i * stride]) : from[i * stride];
+   }
+   // Unused columns never give a bound.
+   for(U32 k = mLandmarks.size(); k < count; k++)
+   {
+      for(U32 i = 0; i < portalCount; i++)
+         mCosts[i * stride + k] = mCosts[i * stride + count + k] = F32_MAX;
+   }
+}
+
+S32 NavMeshLandmarks::findPortal(U32 poly, const F32 *pos) const
+{
+   // Nodes sit exactly on a midpoint, give or take rounding.
+   const F32 tolerance = 0.0001f;
+   const Point3F p(pos[0], pos[1], pos[2]);
+   for(U32 i = mFirstIn[poly]; i < mFirstIn[poly + 1]; i++)
+      if((mPortals[i] - p).lenSquared() <= tolerance * tolerance)
+         return i;
+   return -1;
+}
+
+F32 NavMeshLandmarks::getBound(U32 from, U32 to) const
+{
+   const U32 stride = mCosts.size() / mPortals.size();
+   const U32 count = stride / 2;
+   const F32 *a = &mCosts[from * stride];
+   const F32 *b = &mCosts[to * stride];
+   F32 bound = 0.0f;
+   for(U32 k = 0; k < count; k++)
+   {
+      // Landmark to goal, minus landmark to us.
+      if(a[k] != F32_MAX && b[k] != F32_MAX)
+         bound = getMax(bound, b[k] - a[k]);
+      // Us to landmark, minus goal to landmark.
+      if(a[count + k] != F32_MAX && b[count + k] != F32_MAX)
+         bound = getMax(bound, a[count + k] - b[count + k]);
+   }
+   return bound;
+}
+
+float NavMeshLandmarks::getCost(const dtPolyRef fromRef, const float *fromPos,
+                                const dtPolyRef toRef, const float *toPos) const
+{
+   U32 from, to;
+   if(!mLandmarks.size() || fromRef == toRef || !getIndex(fromRef, from) || !getIndex(toRef, to))
+      return 0.0f;
+
+   // The start node isn't at a portal, so it gets no bound.
+   const S32 portal = findPortal(from, fromPos);
+   if(portal < 0)
+      return 0.0f;
+
+   // The rest of the path enters the goal polygon by one of its portals,
+   // then heads straight for the goal.
+   F32 best = F32_MAX;
+   for(U32 i = mFirstIn[to]; i < mFirstIn[to + 1]; i++)
+   {
+      const Point3F d = mPortals[i] - Point3F(toPos[0], toPos[1], toPos[2]);
+      best = getMin(best, getBound(portal, i) + d.len());
+   }
+   return best == F32_MAX ? 0.0f : best;
+}
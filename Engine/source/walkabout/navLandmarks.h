@@ -0,0 +1,106 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2014 Daniel Buckmaster
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef _NAVLANDMARKS_H_
+#define _NAVLANDMARKS_H_
+
+#include "core/util/tVector.h"
+#include "math/mPoint3.h"
+
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+
+/// @class NavMeshLandmarks
+/// Path costs to and from a few landmark polygons of a dtNavMesh, used as
+/// an A* heuristic. By the triangle inequality, a path from n to t costs
+/// at least d(L,t) - d(L,n) and d(n,L) - d(t,L) for any landmark L, which
+/// is a much closer estimate than straight-line distance in maze-like
+/// areas where the way round is long.
+///
+/// Costs are measured between the portal midpoints a Detour search puts
+/// its nodes at, stepping from the portal a polygon was entered by to the
+/// one it is left by, just as the search does. They cover every polygon
+/// in the mesh, so they are a lower bound for any filter with area costs
+/// of at least 1.
+class NavMeshLandmarks : public dtQueryHeuristic {
+public:
+   NavMeshLandmarks();
+
+   /// Choose landmarks spread across a mesh, and find every portal's
+   /// costs to and from them. Touches nothing but the mesh and ourselves,
+   /// so it may run on any thread.
+   /// @param nm    Mesh to measure.
+   /// @param count Number of landmarks to place.
+   void build(const dtNavMesh *nm, U32 count);
+
+   /// Decode polygon references with another mesh, which must have the
+   /// same parameters and tile refs as the one we were built from.
+   void setMesh(const dtNavMesh *nm) { mMesh = nm; }
+
+   /// Forget all landmarks.
+   void clear();
+
+   /// Number of landmarks we have.
+   U32 size() const { return mLandmarks.size(); }
+
+   /// dtQueryHeuristic
+   float getCost(const dtPolyRef fromRef, const float *fromPos,
+                 const dtPolyRef toRef, const float *toPos) const;
+
+   /// NavMesh versions we were built for.
+   U32 meshVersion, tileVersion;
+
+private:
+   /// Mesh we were built from, used to decode polygon references.
+   const dtNavMesh *mMesh;
+
+   /// Index of each tile's first polygon in our arrays, by tile index.
+   Vector<U32> mTileBase;
+   /// Salt of each tile when we were built.
+   Vector<U32> mTileSalt;
+   /// Number of polygons we know.
+   U32 mPolyCount;
+
+   /// Portals into each polygon are mFirstIn[i] to mFirstIn[i+1].
+   Vector<U32> mFirstIn;
+   /// Midpoint of each portal, in Recast space.
+   Vector<Point3F> mPortals;
+
+   /// Portal index of each landmark.
+   Vector<U32> mLandmarks;
+   /// For each portal, its cost from each landmark, then its cost to each
+   /// landmark. F32_MAX where there is no path.
+   Vector<F32> mCosts;
+
+   /// Find our index for a polygon.
+   /// @return False if the polygon's tile has changed since we were built.
+   bool getIndex(dtPolyRef ref, U32 &idx) const;
+
+   /// Find the portal into a polygon that a search node is at.
+   /// @return -1 if the position isn't at one.
+   S32 findPortal(U32 poly, const F32 *pos) const;
+
+   /// Lower bound on the cost between two portals.
+   F32 getBound(U32 from, U32 to) const;
+};
+
+#endif
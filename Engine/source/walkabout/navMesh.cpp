@@ -24,7 +24,10 @@
 
 #include "navMesh.h"
 #include "navContext.h"
+#include "navObstacle.h"
+#include "navPath.h"
 #include <DetourDebugDraw.h>
+#include <DetourNode.h>
 #include <RecastDebugDraw.h>
 
 #include "math/mathUtils.h"
@@ -41,11 +44,15 @@
 #include "core/stream/bitStream.h"
 #include "math/mathIO.h"
 
+#include "platform/threads/threadPool.h"
+#include "platform/platformIntrinsics.h"
+
 extern bool gEditingMission;
 
 IMPLEMENT_CO_NETOBJECT_V1(NavMesh);
 
 const U32 NavMesh::mMaxVertsPerPoly = 3;
+const NavMesh::CoverRef NavMesh::NullCover = ~(NavMesh::CoverRef)0;
 
 SimObjectPtr<SimSet> NavMesh::smServerSet = NULL;
 
@@ -56,6 +63,12 @@ ImplementEnumType(NavMeshWaterMethod,
    { NavMesh::Impassable, "Impassable", "Treat water as an impassable obstacle.\n" },
 EndImplementEnumType;
 
+ImplementEnumType(NavMeshCoverMethod,
+   "The method used to find cover points in the NavMesh.\n")
+   { NavMesh::Voxels,  "Voxels",  "Find cover in the voxel data while each tile is built.\n" },
+   { NavMesh::Raycast, "Raycast", "Find cover by casting rays against level collision after the build.\n" },
+EndImplementEnumType;
+
 SimSet *NavMesh::getServerSet()
 {
    if(!smServerSet)
@@ -91,6 +104,8 @@ EventManager *NavMesh::getEventManager()
       smEventManager->registerEvent("NavMeshUpdateBox");
       smEventManager->registerEvent("NavMeshObstacleAdded");
       smEventManager->registerEvent("NavMeshObstacleRemoved");
+      smEventManager->registerEvent("NavMeshCoverProgress");
+      smEventManager->registerEvent("NavMeshCoverUpdate");
    }
    return smEventManager;
 }
@@ -174,10 +189,29 @@ NavMesh::NavMesh()
    mLargeCharacters = false;
    mVehicles = false;
 
+   mJumpDownLinks = false;
+   mJumpLinkSmall = 1.0f;
+   mJumpLinkLarge = 3.0f;
+
    mCoverSet = StringTable->insert("");
+   mCoverMethod = Voxels;
    mInnerCover = false;
    mCoverDist = 1.0f;
    mPeekDist = 0.7f;
+   mCoverBatchCount = 0;
+   mCoverGeneration = 0;
+   mTilesX = mTilesY = 0;
+
+   mQueryNodes = 2048;
+   mPathBudget = 1000;
+   mPathQueueHead = 0;
+   mPathCacheSize = 64;
+   mHierarchyTiles = 4;
+   mLandmarkCount = 8;
+   mLandmarkTime = 0;
+   mPathCacheClock = 0;
+   mMeshVersion = mTileVersion = 0;
+   mPathBatchId = 0;
 
    mAlwaysRender = false;
 
@@ -186,6 +220,9 @@ NavMesh::NavMesh()
 
 NavMesh::~NavMesh()
 {
+   cancelPathJobs();
+   cancelPathBatches();
+   freeQueries();
    dtFreeNavMesh(nm);
    nm = NULL;
    delete ctx;
@@ -265,8 +302,18 @@ void NavMesh::initPersistFields()
 
    addGroup("NavMesh Annotations");
 
+   addField("jumpDownLinks", TypeBool, Offset(mJumpDownLinks, NavMesh),
+      "Automatically generate jump, drop and ledge links from the edges of each tile?");
+   addFieldV("jumpLinkSmall", TypeF32, Offset(mJumpLinkSmall, NavMesh), &CommonValidators::PositiveFloat,
+      "Height characters can jump up, and width of gaps they can jump across.");
+   addFieldV("jumpLinkLarge", TypeF32, Offset(mJumpLinkLarge, NavMesh), &CommonValidators::PositiveFloat,
+      "Height characters can safely drop down.");
+
    addField("coverGroup", TypeString, Offset(mCoverSet, NavMesh),
-      "Name of the SimGroup to store cover points in.");
+      "Name of the SimGroup to store CoverPoint objects in while editing.");
+
+   addField("coverMethod", TYPEID<NavMeshCoverMethod>(), Offset(mCoverMethod, NavMesh),
+      "The method to use to find cover points.");
 
    addField("innerCover", TypeBool, Offset(mInnerCover, NavMesh),
       "Add cover points everywhere, not just on corners?");
@@ -305,6 +352,19 @@ void NavMesh::initPersistFields()
       "Any regions with a span count smaller than this value will, if possible, be merged with larger regions.");
    addFieldV("maxPolysPerTile", TypeS32, Offset(mMaxPolysPerTile, NavMesh), &NaturalNumber,
       "The maximum number of polygons allowed in a tile.");
+   addFieldV("queryNodes", TypeS32, Offset(mQueryNodes, NavMesh), &NaturalNumber,
+      "The number of search nodes in each pathfinding query. Larger searches "
+      "can find longer paths, but use more memory.");
+   addFieldV("pathBudget", TypeS32, Offset(mPathBudget, NavMesh), &NaturalNumber,
+      "The total number of search iterations spent on sliced NavPaths each tick.");
+   addFieldV("pathCacheSize", TypeS32, Offset(mPathCacheSize, NavMesh), &PositiveInt,
+      "The number of polygon corridors kept for reuse by later paths. 0 disables the cache.");
+   addFieldV("hierarchyTiles", TypeS32, Offset(mHierarchyTiles, NavMesh), &PositiveInt,
+      "Paths between points at least this many tiles apart are planned between "
+      "tile borders first, then refined. 0 disables this.");
+   addFieldV("landmarks", TypeS32, Offset(mLandmarkCount, NavMesh), &PositiveInt,
+      "The number of landmark polygons used to estimate path costs, which "
+      "speeds up searches through maze-like areas. 0 disables them.");
 
    endGroup("NavMesh Advanced Options");
 
@@ -353,6 +413,11 @@ bool NavMesh::onAdd()
 
 void NavMesh::onRemove()
 {
+   cancelPathJobs();
+   cancelPathBatches();
+   cancelCover();
+   deleteCoverProxies();
+
    if(getEventManager())
       getEventManager()->postEvent("NavMeshRemoved", getIdString());
 
@@ -394,6 +459,8 @@ S32 NavMesh::addLink(const Point3F &from, const Point3F &to, U32 flags)
       else
          mLinkFlags.push_back(JumpFlag);
    }
+   else
+      mLinkFlags.push_back(flags);
    mLinkIDs.push_back(1000 + mCurLinkID);
    mLinkSelectStates.push_back(Unselected);
    mDeleteLinks.push_back(false);
@@ -587,6 +654,13 @@ bool NavMesh::build(bool background, bool saveIntermediates)
 
    ctx->startTimer(RC_TIMER_TOTAL);
 
+   mSnapshots.clear();
+   mPathCache.clear();
+   mHierarchy.clear();
+   mLandmarks.clear();
+   mMeshVersion++;
+   failQueuedPaths();
+   freeQueries();
    dtFreeNavMesh(nm);
    // Allocate a new navmesh.
    nm = dtAllocNavMesh();
@@ -648,6 +722,8 @@ void NavMesh::cancelBuild()
    while(mDirtyTiles.size()) mDirtyTiles.pop();
    ctx->stopTimer(RC_TIMER_TOTAL);
    mBuilding = false;
+   // Nothing else is coming, so let agents replan on what we have.
+   postObstacleEvents();
 }
 
 DefineEngineMethod(NavMesh, cancelBuild, void, (),,
@@ -693,12 +769,36 @@ S32 NavMesh::getTile(Point3F pos)
 {
    if(mBuilding)
       return -1;
-   for(U32 i = 0; i < mTiles.size(); i++)
-   {
-      if(mTiles[i].box.isContained(pos))
-         return i;
-   }
-   return -1;
+   U32 x0, y0, x1, y1;
+   if(!getTileRange(Box3F(pos, pos), x0, y0, x1, y1))
+      return -1;
+   S32 i = getTileIndex(x0, y0);
+   if(i < 0 || !mTiles[i].box.isContained(pos))
+      return -1;
+   return i;
+}
+
+bool NavMesh::getTileRange(const Box3F &box, U32 &x0, U32 &y0, U32 &x1, U32 &y1) const
+{
+   if(!mTiles.size())
+      return false;
+   // Tiles are laid out in a regular grid from the first one.
+   const Tile &first = mTiles[0];
+   const F32 tcs = first.bmax[0] - first.bmin[0];
+   if(tcs <= 0.0f)
+      return false;
+   const Box3F rc = DTStoRC(box);
+   const S32 minX = mFloor((rc.minExtents.x - first.bmin[0]) / tcs);
+   const S32 maxX = mFloor((rc.maxExtents.x - first.bmin[0]) / tcs);
+   const S32 minY = mFloor((rc.minExtents.z - first.bmin[2]) / tcs);
+   const S32 maxY = mFloor((rc.maxExtents.z - first.bmin[2]) / tcs);
+   if(maxX < 0 || maxY < 0 || minX >= (S32)mTilesX || minY >= (S32)mTilesY)
+      return false;
+   x0 = getMax(minX, 0);
+   y0 = getMax(minY, 0);
+   x1 = getMin(maxX, (S32)mTilesX - 1);
+   y1 = getMin(maxY, (S32)mTilesY - 1);
+   return true;
 }
 
 Box3F NavMesh::getTileBox(U32 id)
@@ -713,9 +813,22 @@ void NavMesh::updateTiles(bool dirty)
    if(!isProperlyAdded())
       return;
 
+   cancelCover();
+
+   // Keep displaying cover if we were already.
+   const bool showCover = !mCoverProxies.isNull();
+   deleteCoverProxies();
+
    mTiles.clear();
    mTileData.clear();
+   mCover.clear();
+   mTileVersions.clear();
+   // Snapshots are only updated tile by tile within the same grid.
+   mSnapshots.clear();
+   mTilesX = mTilesY = 0;
    while(mDirtyTiles.size()) mDirtyTiles.pop();
+   if(showCover)
+      createCoverProxies();
 
    const Box3F &box = DTStoRC(getWorldBox());
    if(box.isEmpty())
@@ -728,6 +841,8 @@ void NavMesh::updateTiles(bool dirty)
    const U32 tw = (cfg.width  + ts-1) / ts;
    const U32 th = (cfg.height + ts-1) / ts;
    const F32 tcs = cfg.tileSize * cfg.cs;
+   mTilesX = tw;
+   mTilesY = th;
 
    // Iterate over tiles.
    F32 tileBmin[3], tileBmax[3];
@@ -751,15 +866,24 @@ void NavMesh::updateTiles(bool dirty)
          if(dirty)
             mDirtyTiles.push(mTiles.size() - 1);
 
-         if(mSaveIntermediates)
-            mTileData.increment();
+         mTileData.increment();
+         mCover.increment();
+         mTileVersions.push_back(mTileVersion);
       }
    }
 }
 
 void NavMesh::processTick(const Move *move)
 {
+   updatePathJobs();
+   updatePathBatches();
+   updateLandmarks();
+   processObstacles();
    buildNextTile();
+   updateHierarchy();
+   updateCover();
+   updatePaths();
+   startPathJobs();
 }
 
 void NavMesh::buildNextTile()
@@ -771,23 +895,27 @@ void NavMesh::buildNextTile()
       mDirtyTiles.pop();
       const Tile &tile = mTiles[i];
       // Intermediate data for tile build.
-      TileData tempdata;
-      TileData &tdata = mSaveIntermediates ? mTileData[i] : tempdata;
+      TileData &tdata = mTileData[i];
       // Generate navmesh for this tile.
       U32 dataSize = 0;
       unsigned char* data = buildTileData(tile, tdata, dataSize);
+      // Voxel cover comes out of the build; anything else is now stale.
+      const bool hadCover = mCover[i].valid;
+      cancelTileCover(i);
+      if(tdata.hasCover)
+         setTileCover(i, tdata.cover);
+      else
+         clearTileCover(i);
+      tdata.cover.clear();
+      // Keep the compact heightfield so obstacles can carve it later.
+      if(!mSaveIntermediates)
+         tdata.freeIntermediates(true);
       if(data)
       {
-         // Remove any previous data.
-         nm->removeTile(nm->getTileRefAt(tile.x, tile.y, 0), 0, 0);
-         // Add new data (navmesh owns and deletes the data).
-         dtStatus status = nm->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0);
-         int success = 1;
-         if(dtStatusFailed(status))
-         {
-            success = 0;
-            dtFree(data);
-         }
+         int success = replaceTile(tile, data, dataSize) ? 1 : 0;
+         // Raycast cover again, but only if this tile had some before.
+         if(success && hadCover && !mCover[i].valid)
+            queueTileCover(i);
          if(getEventManager())
          {
             String str = String::ToString("%d %d %d (%d, %d) %d %.3f %s",
@@ -805,6 +933,7 @@ void NavMesh::buildNextTile()
       if(!mDirtyTiles.size())
       {
          ctx->stopTimer(RC_TIMER_TOTAL);
+         updateConnectivity();
          if(getEventManager())
          {
             String str = String::ToString("%d %.3f", getId(), ctx->getAccumulatedTime(RC_TIMER_TOTAL) / 1000.0f);
@@ -812,6 +941,8 @@ void NavMesh::buildNextTile()
             setMaskBits(LoadFlag);
          }
          mBuilding = false;
+         // Obstacles that needed a rebuild are in the mesh now.
+         postObstacleEvents();
       }
    }
 }
@@ -822,8 +953,35 @@ static void buildCallback(SceneObject* object,void *key)
    object->buildPolyList(info->context,info->polyList,info->boundingBox,info->boundingSphere);
 }
 
+bool NavMesh::replaceTile(const Tile &tile, unsigned char *data, U32 dataSize)
+{
+   invalidateCorridors(tile.x, tile.y);
+   mHierarchy.markTile(tile.x, tile.y);
+   mTileVersion++;
+   // Snapshots pick this tile up the next time they are idle.
+   const S32 t = getTileIndex(tile.x, tile.y);
+   if(t >= 0)
+      mTileVersions[t] = mTileVersion;
+
+   // Remove any previous data.
+   nm->removeTile(nm->getTileRefAt(tile.x, tile.y, 0), 0, 0);
+   if(!data)
+      return true;
+   // Add new data (navmesh owns and deletes the data).
+   dtStatus status = nm->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0);
+   if(dtStatusFailed(status))
+   {
+      dtFree(data);
+      return false;
+   }
+   return true;
+}
+
 unsigned char *NavMesh::buildTileData(const Tile &tile, TileData &data, U32 &dataSize)
 {
+   // Clear out anything left from the last build of this tile.
+   data.freeAll();
+
    // Push out tile boundaries a bit.
    F32 tileBmin[3], tileBmax[3];
    rcVcopy(tileBmin, tile.bmin);
@@ -924,12 +1082,22 @@ unsigned char *NavMesh::buildTileData(const Tile &tile, TileData &data, U32 &dat
       return NULL;
    }
 
-   //--------------------------
-   // Todo: mark areas here.
-   //const ConvexVolume* vols = m_geom->getConvexVolumes();
-   //for (int i  = 0; i < m_geom->getConvexVolumeCount(); ++i)
-      //rcMarkConvexPolyArea(m_ctx, vols[i].verts, vols[i].nverts, vols[i].hmin, vols[i].hmax, (unsigned char)vols[i].area, *m_chf);
-   //--------------------------
+   // Remember the uncarved areas so obstacles can be re-applied later.
+   data.areas.setSize(data.chf->spanCount);
+   dMemcpy(data.areas.address(), data.chf->areas, data.chf->spanCount);
+
+   generateCover(data);
+
+   return buildTileMesh(tile, data, dataSize);
+}
+
+unsigned char *NavMesh::buildTileMesh(const Tile &tile, TileData &data, U32 &dataSize)
+{
+   data.freeMesh();
+
+   // Restore areas from the last voxelisation and carve obstacles into them.
+   dMemcpy(data.chf->areas, data.areas.address(), data.areas.size());
+   markObstacles(tile, *data.chf);
 
    if(false)
    {
@@ -1010,6 +1178,42 @@ unsigned char *NavMesh::buildTileData(const Tile &tile, TileData &data, U32 &dat
          data.pm->flags[i] |= SwimFlag;
    }
 
+   // Links only need generating when we've just voxelised this tile.
+   if(data.hf)
+      generateLinks(data);
+
+   // Gather the links that start in this tile - Detour ignores the rest.
+   Vector<F32> linkVerts;
+   Vector<F32> linkRads;
+   Vector<U8> linkDirs;
+   Vector<U8> linkAreas;
+   Vector<unsigned short> linkFlags;
+   Vector<U32> linkIDs;
+   for(U32 i = 0; i < mLinkIDs.size(); i++)
+   {
+      const F32 *start = &mLinkVerts[i*6];
+      if(start[0] < tile.bmin[0] || start[0] >= tile.bmax[0] ||
+         start[2] < tile.bmin[2] || start[2] >= tile.bmax[2])
+         continue;
+      for(U32 j = 0; j < 6; j++)
+         linkVerts.push_back(start[j]);
+      linkRads.push_back(mLinkRads[i]);
+      linkDirs.push_back(mLinkDirs[i]);
+      linkAreas.push_back(mLinkAreas[i]);
+      linkFlags.push_back(mLinkFlags[i]);
+      linkIDs.push_back(mLinkIDs[i]);
+   }
+   for(U32 i = 0; i < data.linkFlags.size(); i++)
+   {
+      for(U32 j = 0; j < 6; j++)
+         linkVerts.push_back(data.linkVerts[i*6 + j]);
+      linkRads.push_back(mWalkableRadius);
+      linkDirs.push_back(0);
+      linkAreas.push_back(OffMeshArea);
+      linkFlags.push_back(data.linkFlags[i]);
+      linkIDs.push_back(0);
+   }
+
    unsigned char* navData = 0;
    int navDataSize = 0;
 
@@ -1030,13 +1234,13 @@ unsigned char *NavMesh::buildTileData(const Tile &tile, TileData &data, U32 &dat
    params.detailTris = data.pmd->tris;
    params.detailTriCount = data.pmd->ntris;
 
-   params.offMeshConVerts = mLinkVerts.address();
-   params.offMeshConRad = mLinkRads.address();
-   params.offMeshConDir = mLinkDirs.address();
-   params.offMeshConAreas = mLinkAreas.address();
-   params.offMeshConFlags = mLinkFlags.address();
-   params.offMeshConUserID = mLinkIDs.address();
-   params.offMeshConCount = mLinkIDs.size();
+   params.offMeshConVerts = linkVerts.address();
+   params.offMeshConRad = linkRads.address();
+   params.offMeshConDir = linkDirs.address();
+   params.offMeshConAreas = linkAreas.address();
+   params.offMeshConFlags = linkFlags.address();
+   params.offMeshConUserID = linkIDs.address();
+   params.offMeshConCount = linkIDs.size();
 
    params.walkableHeight = mWalkableHeight;
    params.walkableRadius = mWalkableRadius;
@@ -1049,6 +1253,8 @@ unsigned char *NavMesh::buildTileData(const Tile &tile, TileData &data, U32 &dat
    params.cs = cfg.cs;
    params.ch = cfg.ch;
    params.buildBvTree = true;
+   // Cells as wide as the area we search for polygons near a point.
+   params.polyGridCellSize = mWalkableRadius * 4.0f;
 
    if(!dtCreateNavMeshData(&params, &navData, &navDataSize))
    {
@@ -1062,6 +1268,182 @@ unsigned char *NavMesh::buildTileData(const Tile &tile, TileData &data, U32 &dat
    return navData;
 }
 
+void NavMesh::generateLinks(TileData &data)
+{
+   data.linkVerts.clear();
+   data.linkFlags.clear();
+   if(!mJumpDownLinks || !data.hf || !data.chf || !data.pm)
+      return;
+
+   const rcPolyMesh &pm = *data.pm;
+   const S32 nvp = pm.nvp;
+   // Poly mesh vertices don't include the tile border, heightfield cells do.
+   const F32 border = data.chf->borderSize;
+   // Distance between links along an edge, in cells.
+   const F32 spacing = mWalkableRadius * 4.0f / cfg.cs;
+
+   for(S32 i = 0; i < pm.npolys; i++)
+   {
+      if(pm.areas[i] != GroundArea)
+         continue;
+      const unsigned short *p = &pm.polys[i*nvp*2];
+
+      // Find the centre of the polygon so we know which way is out.
+      S32 nverts = 0;
+      F32 cx = 0.0f, cz = 0.0f;
+      for(; nverts < nvp && p[nverts] != RC_MESH_NULL_IDX; nverts++)
+      {
+         cx += pm.verts[p[nverts]*3];
+         cz += pm.verts[p[nverts]*3 + 2];
+      }
+      if(!nverts)
+         continue;
+      cx /= nverts;
+      cz /= nverts;
+
+      for(S32 j = 0; j < nverts; j++)
+      {
+         // Only look at edges with no neighbour. Edges on the tile boundary
+         // are marked as portals, not left empty.
+         if(p[nvp + j] != RC_MESH_NULL_IDX)
+            continue;
+         const unsigned short *va = &pm.verts[p[j]*3];
+         const unsigned short *vb = &pm.verts[p[(j+1) % nverts]*3];
+         const F32 dx = (F32)vb[0] - va[0];
+         const F32 dz = (F32)vb[2] - va[2];
+         const F32 len = mSqrt(dx*dx + dz*dz);
+         if(len < 1.0f)
+            continue;
+         F32 nx = dz / len, nz = -dx / len;
+         if(((va[0] + vb[0]) * 0.5f - cx) * nx + ((va[2] + vb[2]) * 0.5f - cz) * nz < 0.0f)
+         {
+            nx = -nx;
+            nz = -nz;
+         }
+
+         const S32 samples = getMax(1, (S32)(len / spacing));
+         for(S32 k = 0; k < samples; k++)
+         {
+            const F32 t = (k + 0.5f) / samples;
+            const F32 x = va[0] + dx * t;
+            const F32 z = va[2] + dz * t;
+            const S32 y = va[1] + (S32)(((S32)vb[1] - (S32)va[1]) * t);
+            F32 end[3];
+            U16 flags = 0;
+            if(!probeLink(data, x + border, z + border, y, nx, nz, end, flags))
+               continue;
+            data.linkVerts.push_back(pm.bmin[0] + x * pm.cs);
+            data.linkVerts.push_back(pm.bmin[1] + y * pm.ch);
+            data.linkVerts.push_back(pm.bmin[2] + z * pm.cs);
+            data.linkVerts.push_back(end[0]);
+            data.linkVerts.push_back(end[1]);
+            data.linkVerts.push_back(end[2]);
+            data.linkFlags.push_back(flags);
+         }
+      }
+   }
+}
+
+bool NavMesh::probeLink(const TileData &data, F32 x, F32 z, S32 y, F32 nx, F32 nz, F32 *end, U16 &flags)
+{
+   const rcHeightfield &hf = *data.hf;
+   const rcCompactHeightfield &chf = *data.chf;
+   const S32 climb = cfg.walkableClimb;
+   const S32 height = cfg.walkableHeight;
+   const S32 jumpUp = (S32)mCeil(mJumpLinkSmall / cfg.ch);
+   const S32 dropDown = (S32)mCeil(mJumpLinkLarge / cfg.ch);
+   // Far enough to get past the eroded borders on both sides of a gap.
+   const S32 steps = (S32)mCeil((mWalkableRadius * 2.0f + mJumpLinkSmall) / cfg.cs);
+
+   bool gap = false, climbing = false;
+   for(S32 k = 1; k <= steps; k++)
+   {
+      const S32 cx = (S32)mFloor(x + nx * k);
+      const S32 cz = (S32)mFloor(z + nz * k);
+      if(cx < 0 || cz < 0 || cx >= chf.width || cz >= chf.height)
+         return false;
+
+      // Is there anything solid where our body would be?
+      bool blocked = false;
+      for(const rcSpan *s = hf.spans[cx + cz*hf.width]; s; s = s->next)
+      {
+         if((S32)s->smin < y + height && (S32)s->smax > y + climb)
+         {
+            blocked = true;
+            break;
+         }
+      }
+
+      // Find the floors in this column at our level, just above and just below.
+      const rcCompactCell &c = chf.cells[cx + cz*chf.width];
+      S32 level = -1, above = -1, below = -1;
+      for(S32 i = c.index, ni = c.index + c.count; i < ni; i++)
+      {
+         const S32 sy = chf.spans[i].y;
+         if(mAbs(sy - y) <= climb)
+            level = i;
+         else if(sy > y && sy - y <= jumpUp)
+         {
+            if(above < 0 || sy < chf.spans[above].y)
+               above = i;
+         }
+         else if(sy < y && y - sy <= dropDown)
+         {
+            if(below < 0 || sy > chf.spans[below].y)
+               below = i;
+         }
+      }
+
+      S32 land = -1;
+      if(blocked)
+      {
+         // We can only get past a wall by jumping on top of it.
+         if(above < 0)
+            return false;
+         climbing = true;
+         if(chf.areas[above] != RC_NULL_AREA)
+         {
+            land = above;
+            flags = JumpFlag;
+         }
+      }
+      else if(climbing)
+      {
+         // Don't try to hop over thin walls.
+         return false;
+      }
+      else if(level >= 0)
+      {
+         if(chf.areas[level] != RC_NULL_AREA)
+         {
+            // Walkable ground without a gap is just another part of the mesh.
+            if(!gap)
+               return false;
+            land = level;
+            flags = LedgeFlag;
+         }
+      }
+      else
+      {
+         gap = true;
+         if(below >= 0 && chf.areas[below] != RC_NULL_AREA)
+         {
+            land = below;
+            flags = DropFlag;
+         }
+      }
+
+      if(land >= 0)
+      {
+         end[0] = chf.bmin[0] + (cx + 0.5f) * chf.cs;
+         end[1] = chf.bmin[1] + chf.spans[land].y * chf.ch;
+         end[2] = chf.bmin[2] + (cz + 0.5f) * chf.cs;
+         return true;
+      }
+   }
+   return false;
+}
+
 /// This method should never be called in a separate thread to the rendering
 /// or pathfinding logic. It directly replaces data in the dtNavMesh for
 /// this NavMesh object.
@@ -1138,195 +1520,2191 @@ DefineEngineMethod(NavMesh, buildLinks, void, (),,
    object->buildLinks();
 }
 
-void NavMesh::deleteCoverPoints()
-{
-   SimSet *set = NULL;
-   if(Sim::findObject(mCoverSet, set))
-      set->deleteAllObjects();
-}
+/// Idle queries beyond this many are freed rather than kept.
+static const U32 MaxPooledQueries = 16;
 
-DefineEngineMethod(NavMesh, deleteCoverPoints, void, (),,
-   "@brief Remove all cover points for this NavMesh.")
+dtNavMeshQuery *NavMesh::acquireQuery(U32 maxNodes)
 {
-   object->deleteCoverPoints();
+   if(!nm)
+      return NULL;
+   if(!maxNodes)
+      maxNodes = getMax(mQueryNodes, 1);
+
+   // Take the smallest idle query that's big enough.
+   dtNavMeshQuery *query = NULL;
+   {
+      MutexHandle lock;
+      lock.lock(&mQueryMutex);
+      for(U32 i = 0; i < mQueryPool.size(); i++)
+      {
+         if(mQueryPool[i].nodes >= maxNodes)
+         {
+            query = mQueryPool[i].query;
+            mQueryPool.erase(i);
+            break;
+         }
+      }
+   }
+
+   if(!query)
+      query = dtAllocNavMeshQuery();
+   if(!query)
+      return NULL;
+
+   // Reinitialising keeps the node pool if its size doesn't change, and
+   // attaches the query to our current dtNavMesh.
+   const U32 nodes = query->getNodePool() ? query->getNodePool()->getMaxNodes() : maxNodes;
+   if(dtStatusFailed(query->init(nm, getMax(nodes, maxNodes))))
+   {
+      dtFreeNavMeshQuery(query);
+      return NULL;
+   }
+   return query;
 }
 
-bool NavMesh::createCoverPoints()
+void NavMesh::releaseQuery(dtNavMeshQuery *query)
 {
-   if(!nm || !isServerObject())
-      return false;
+   if(!query)
+      return;
 
-   SimSet *set = NULL;
-   if(Sim::findObject(mCoverSet, set))
+   if(!nm || !query->getNodePool())
    {
-      set->deleteAllObjects();
+      dtFreeNavMeshQuery(query);
+      return;
    }
-   else
+   query->setHeuristic(NULL);
+   // Point queries used on a snapshot or an old dtNavMesh back at ours.
+   if(query->getAttachedNavMesh() != nm)
+      query->init(nm, query->getNodePool()->getMaxNodes());
+
+   PooledQuery p;
+   p.query = query;
+   p.nodes = query->getNodePool()->getMaxNodes();
+
+   MutexHandle lock;
+   lock.lock(&mQueryMutex);
+   if(mQueryPool.size() >= MaxPooledQueries)
    {
-      set = new SimGroup();
-      if(set->registerObject(mCoverSet))
-      {
-         getGroup()->addObject(set);
-      }
-      else
-      {
-         delete set;
-         set = getGroup();
-      }
+      dtFreeNavMeshQuery(query);
+      return;
    }
+   U32 i = 0;
+   while(i < mQueryPool.size() && mQueryPool[i].nodes < p.nodes)
+      i++;
+   mQueryPool.insert(i, p);
+}
 
-   dtNavMeshQuery *query = dtAllocNavMeshQuery();
-   if(!query || dtStatusFailed(query->init(nm, 1)))
-      return false;
-
-   dtQueryFilter f;
+void NavMesh::queuePath(NavPath *path)
+{
+   for(U32 i = 0; i < mPathQueue.size(); i++)
+   {
+      if(mPathQueue[i] == path)
+         return;
+   }
+   mPathQueue.push_back(path);
+}
 
-   // Iterate over all polys in our navmesh.
-   const int MAX_SEGS = 6;
-   for(U32 i = 0; i < nm->getMaxTiles(); ++i)
+void NavMesh::dequeuePath(NavPath *path)
+{
+   for(U32 i = 0; i < mPathQueue.size(); i++)
    {
-      const dtMeshTile* tile = ((const dtNavMesh*)nm)->getTile(i);
-      if(!tile->header) continue;
-      const dtPolyRef base = nm->getPolyRefBase(tile);
-      for(U32 j = 0; j < tile->header->polyCount; ++j)
+      if(mPathQueue[i] == path)
       {
-         const dtPolyRef ref = base | j;
-         float segs[MAX_SEGS*6];
-         int nsegs = 0;
-         query->getPolyWallSegments(ref, &f, segs, NULL, &nsegs, MAX_SEGS);
-         for(int j = 0; j < nsegs; ++j)
-         {
-            const float* sa = &segs[j*6];
-            const float* sb = &segs[j*6+3];
-            Point3F a = RCtoDTS(sa), b = RCtoDTS(sb);
-            F32 len = (b - a).len();
-            if(len < mWalkableRadius * 2)
-               continue;
-            Point3F edge = b - a;
-            edge.normalize();
-            // Number of points to try placing - for now, one at each end.
-            U32 pointCount = (len > mWalkableRadius * 4) ? 2 : 1;
-            for(U32 i = 0; i < pointCount; i++)
-            {
-               MatrixF mat;
-               Point3F pos;
-               // If we're only placing one point, put it in the middle.
-               if(pointCount == 1)
-                  pos = a + edge * len / 2;
-               // Otherwise, stand off from edge ends.
-               else
-               {
-                  if(i % 2)
-                     pos = a + edge * (i/2+1) * mWalkableRadius;
-                  else
-                     pos = b - edge * (i/2+1) * mWalkableRadius;
-               }
-               CoverPointData data;
-               if(testEdgeCover(pos, edge, data))
-               {
-                  CoverPoint *m = new CoverPoint();
-                  if(!m->registerObject())
-                     delete m;
-                  else
-                  {
-                     m->setTransform(data.trans);
-                     m->setSize(data.size);
-                     m->setPeek(data.peek[0], data.peek[1], data.peek[2]);
-                     if(set)
-                        set->addObject(m);
-                  }
-               }
-            }
-         }
+         mPathQueue.erase(i);
+         if(mPathQueueHead > i)
+            mPathQueueHead--;
+         return;
       }
    }
-   return true;
 }
 
-DefineEngineMethod(NavMesh, createCoverPoints, bool, (),,
-   "@brief Create cover points for this NavMesh.")
+void NavMesh::failQueuedPaths()
 {
-   return object->createCoverPoints();
+   // Finalising takes each path out of the queue, so work from a copy.
+   Vector<SimObjectPtr<NavPath> > paths = mPathQueue;
+   for(U32 i = 0; i < paths.size(); i++)
+   {
+      NavPath *path = paths[i];
+      if(!path)
+         continue;
+      path->abort();
+      mFailedPaths.push_back(path);
+   }
+   mPathQueue.clear();
+   mPathQueueHead = 0;
 }
 
-bool NavMesh::testEdgeCover(const Point3F &pos, const VectorF &dir, CoverPointData &data)
+void NavMesh::updatePaths()
 {
-   data.peek[0] = data.peek[1] = data.peek[2] = false;
-   // Get the edge normal.
-   Point3F norm;
-   mCross(dir, Point3F(0, 0, 1), &norm);
-   RayInfo ray;
-   U32 hits = 0;
-   for(U32 j = 0; j < CoverPoint::NumSizes; j++)
+   // Listeners may replan, which they can only do once we have a mesh
+   // again. Paths that have been replanned since don't need telling.
+   Vector<SimObjectPtr<NavPath> > failed = mFailedPaths;
+   mFailedPaths.clear();
+   for(U32 i = 0; i < failed.size(); i++)
    {
-      Point3F test = pos + Point3F(0.0f, 0.0f, mWalkableHeight * j / CoverPoint::NumSizes);
-      if(getContainer()->castRay(test, test + norm * mCoverDist, StaticObjectType, &ray))
-      {
-         // Test peeking.
-         Point3F left = test + dir * mPeekDist;
-         data.peek[0] = !getContainer()->castRay(test, left, StaticObjectType, &ray)
-            && !getContainer()->castRay(left, left + norm * mCoverDist, StaticObjectType, &ray);
+      NavPath *path = failed[i];
+      if(path && !path->success() && !path->isPlanning())
+         path->mPlannedSignal.trigger(path, false);
+   }
 
-         Point3F right = test - dir * mPeekDist;
-         data.peek[1] = !getContainer()->castRay(test, right, StaticObjectType, &ray)
-            && !getContainer()->castRay(right, right + norm * mCoverDist, StaticObjectType, &ray);
+   // Forget paths that were deleted without telling us.
+   for(U32 i = 0; i < mPathQueue.size();)
+   {
+      if(mPathQueue[i].isNull())
+         mPathQueue.erase(i);
+      else
+         i++;
+   }
+   const U32 n = mPathQueue.size();
+   if(!n)
+      return;
 
-         Point3F over = test + Point3F(0, 0, 1) * 0.2f;
-         data.peek[2] = !getContainer()->castRay(test, over, StaticObjectType, &ray)
-            && !getContainer()->castRay(over, over + norm * mCoverDist, StaticObjectType, &ray);
+   // Take paths in round-robin order from where we left off last tick, then
+   // move higher priorities to the front. The sort is stable, so paths of
+   // equal priority keep their turns.
+   Vector<SimObjectPtr<NavPath> > order;
+   order.reserve(n);
+   for(U32 i = 0; i < n; i++)
+      order.push_back(mPathQueue[(mPathQueueHead + i) % n]);
+   for(U32 i = 1; i < n; i++)
+   {
+      SimObjectPtr<NavPath> p = order[i];
+      S32 j = i - 1;
+      while(j >= 0 && order[j]->mPriority < p->mPriority)
+      {
+         order[j + 1] = order[j];
+         j--;
+      }
+      order[j + 1] = p;
+   }
 
-         if(mInnerCover || data.peek[0] || data.peek[1] || data.peek[2])
-            hits++;
-         // If we couldn't peek here, we may be able to peek further up.
+   S32 budget = mPathBudget;
+   U32 served = 0;
+   for(U32 i = 0; i < order.size() && budget > 0; i++)
+   {
+      NavPath *path = order[i];
+      // A callback may have deleted it.
+      if(!path)
+         continue;
+      S32 iterations = getMin(budget, path->mMaxIterations);
+      const bool more = path->step(iterations);
+      budget -= getMax(iterations, 1);
+      served++;
+      if(!more)
+      {
+         // Finalising takes the path out of our queue.
+         path->finalise();
+         path->mPlannedSignal.trigger(path, path->success());
       }
-      else
-         // No cover at this height - break off.
-         break;
    }
-   if(hits > 0)
+
+   if(mPathQueue.size())
+      mPathQueueHead = (mPathQueueHead + served) % mPathQueue.size();
+   else
+      mPathQueueHead = 0;
+}
+
+/// Runs a NavPathJob on a ThreadPool thread.
+class NavPathWorkItem : public ThreadPool::WorkItem
+{
+public:
+   NavPathWorkItem(NavPathJob *job) : mJob(job) {}
+
+protected:
+   virtual void execute()
    {
-      data.size = (CoverPoint::Size)(hits - 1);
-      data.trans = MathUtils::createOrientFromDir(norm);
-      data.trans.setPosition(pos);
+      mJob->run();
    }
-   return hits > 0;
+
+   ThreadSafeRef<NavPathJob> mJob;
+};
+
+void NavMesh::queuePathJob(NavPathJob *job)
+{
+   mPathJobs.push_back(job);
 }
 
-void NavMesh::renderToDrawer()
+bool NavMesh::pathJobsRunning() const
 {
-   dd.clear();
-   // Recast debug draw
-   NetObject *no = getServerObject();
-   if(no)
+   for(U32 i = 0; i < mPathJobs.size(); i++)
    {
-      NavMesh *n = static_cast<NavMesh*>(no);
+      const NavPathJob *job = mPathJobs[i];
+      if(job->started && !dAtomicRead(const_cast<NavPathJob*>(job)->done))
+         return true;
+   }
+   return false;
+}
 
-      if(n->nm)
+void NavMesh::updatePathJobs()
+{
+   for(U32 i = 0; i < mPathJobs.size();)
+   {
+      ThreadSafeRef<NavPathJob> job = mPathJobs[i];
+      if(!job->started || !dAtomicRead(job->done))
       {
-         dd.beginGroup(0);
-         duDebugDrawNavMesh       (&dd, *n->nm, 0);
-         dd.beginGroup(1);
-         duDebugDrawNavMeshPortals(&dd, *n->nm);
-         dd.beginGroup(2);
-         duDebugDrawNavMeshBVTree (&dd, *n->nm);
+         i++;
+         continue;
       }
+      // Completing may queue more jobs, so take this one out first.
+      mPathJobs.erase(i);
+      releaseQuery(job->query);
+      job->query = NULL;
+      releaseSnapshot(job->snapshot);
+      job->snapshot = NULL;
+      job->mesh = NULL;
+      completePathJob(job);
    }
 }
 
-void NavMesh::prepRenderImage(SceneRenderState *state)
+void NavMesh::completePathJob(NavPathJob *job)
 {
-   ObjectRenderInst *ri = state->getRenderPass()->allocInst<ObjectRenderInst>();
-   ri->renderDelegate.bind(this, &NavMesh::render);
-   ri->type = RenderPassManager::RIT_Object;
-   ri->translucentSort = true;
-   ri->defaultKey = 1;
-   state->getRenderPass()->addInst(ri);
+   NavPath *path = job->path;
+   if(!path || !path->completeJob(job))
+      return;
+   // Nothing may touch the path after this; a listener can delete it.
+   path->mPlannedSignal.trigger(path, path->success());
 }
 
-void NavMesh::render(ObjectRenderInst *ri, SceneRenderState *state, BaseMatInstance *overrideMat)
+ThreadSafeRef<NavMeshSnapshot> NavMesh::acquireSnapshot()
 {
-   if(overrideMat)
-      return;
+   if(!nm)
+      return NULL;
+
+   // Readers can share a snapshot that's already current. Otherwise,
+   // update the newest one nobody is reading.
+   S32 found = -1;
+   for(S32 i = mSnapshots.size() - 1; i >= 0; i--)
+   {
+      NavMeshSnapshot *s = mSnapshots[i];
+      if(s->tileVersion == mTileVersion)
+      {
+         found = i;
+         break;
+      }
+      if(!s->readers)
+      {
+         if(syncSnapshot(s))
+            found = i;
+         else
+            mSnapshots.erase(i);
+         break;
+      }
+   }
+
+   ThreadSafeRef<NavMeshSnapshot> snapshot;
+   if(found >= 0)
+   {
+      snapshot = mSnapshots[found];
+      mSnapshots.erase(found);
+   }
+   else
+   {
+      snapshot = createSnapshot();
+      if(snapshot.isNull())
+         return NULL;
+   }
+   // Keep the newest snapshot at the end.
+   mSnapshots.push_back(snapshot);
+   snapshot->readers++;
+   return snapshot;
+}
+
+void NavMesh::releaseSnapshot(NavMeshSnapshot *snapshot)
+{
+   if(!snapshot || !snapshot->readers)
+      return;
+   snapshot->readers--;
+   if(snapshot->readers)
+      return;
+   // Only the newest idle snapshot is worth updating later. The others are
+   // freed once their last reference goes.
+   bool keptIdle = false;
+   for(S32 i = mSnapshots.size() - 1; i >= 0; i--)
+   {
+      if(mSnapshots[i]->readers)
+         continue;
+      if(keptIdle)
+         mSnapshots.erase(i);
+      keptIdle = true;
+   }
+}
+
+bool NavMesh::syncSnapshot(NavMeshSnapshot *snapshot)
+{
+   PROFILE_SCOPE(NavMesh_syncSnapshot);
+
+   if(snapshot->meshVersion != mMeshVersion)
+      return false;
+
+   // Take out every changed tile before adding any back, since the new
+   // tiles may have taken each other's slots in our mesh.
+   dtNavMesh *dst = snapshot->nm;
+   const dtNavMesh *src = nm;
+   for(U32 i = 0; i < mTiles.size(); i++)
+   {
+      if(mTileVersions[i] > snapshot->tileVersion)
+         dst->removeTile(dst->getTileRefAt(mTiles[i].x, mTiles[i].y, 0), 0, 0);
+   }
+   for(U32 i = 0; i < mTiles.size(); i++)
+   {
+      if(mTileVersions[i] <= snapshot->tileVersion)
+         continue;
+      const dtMeshTile *tile = src->getTileAt(mTiles[i].x, mTiles[i].y, 0);
+      if(!tile || !tile->header || !tile->dataSize)
+         continue;
+      unsigned char *data = (unsigned char*)dtAlloc(tile->dataSize, DT_ALLOC_PERM);
+      if(!data)
+         return false;
+      dMemcpy(data, tile->data, tile->dataSize);
+      if(dtStatusFailed(dst->addTile(data, tile->dataSize, DT_TILE_FREE_DATA, src->getTileRef(tile), 0)))
+      {
+         dtFree(data);
+         return false;
+      }
+   }
+
+   snapshot->tileVersion = mTileVersion;
+   return true;
+}
+
+ThreadSafeRef<NavMeshSnapshot> NavMesh::createSnapshot()
+{
+   PROFILE_SCOPE(NavMesh_createSnapshot);
+
+   NavMeshSnapshot *snapshot = new NavMeshSnapshot();
+   ThreadSafeRef<NavMeshSnapshot> ref(snapshot);
+   snapshot->nm = dtAllocNavMesh();
+   if(!snapshot->nm || dtStatusFailed(snapshot->nm->init(nm->getParams())))
+   {
+      Con::errorf("Could not allocate snapshot of NavMesh %s", getIdString());
+      return NULL;
+   }
+   snapshot->meshVersion = mMeshVersion;
+   snapshot->tileVersion = mTileVersion;
+
+   // Tiles link into their own data, so each snapshot needs its own copy.
+   // Keeping tile refs means polygon refs are the same in both meshes.
+   const dtNavMesh *src = nm;
+   for(S32 i = 0; i < src->getMaxTiles(); i++)
+   {
+      const dtMeshTile *tile = src->getTile(i);
+      if(!tile || !tile->header || !tile->dataSize)
+         continue;
+      unsigned char *data = (unsigned char*)dtAlloc(tile->dataSize, DT_ALLOC_PERM);
+      if(!data)
+         return NULL;
+      dMemcpy(data, tile->data, tile->dataSize);
+      if(dtStatusFailed(snapshot->nm->addTile(data, tile->dataSize, DT_TILE_FREE_DATA, src->getTileRef(tile), 0)))
+         dtFree(data);
+   }
+
+   return ref;
+}
+
+void NavMesh::startPathJobs()
+{
+   for(U32 i = 0; i < mPathJobs.size(); i++)
+   {
+      NavPathJob *job = mPathJobs[i];
+      if(job->started)
+         continue;
+      job->started = true;
+      // Run against the tiles as they are now, however they change while
+      // the job runs.
+      job->snapshot = acquireSnapshot();
+      if(job->snapshot.isNull())
+      {
+         job->status = DT_FAILURE;
+         dCompareAndSwap(job->done, 0, 1);
+         continue;
+      }
+      job->mesh = job->snapshot->nm;
+      job->query->init(job->mesh, job->query->getNodePool()->getMaxNodes());
+      // Landmarks may be rebuilt while the job runs.
+      job->query->setHeuristic(NULL);
+      ThreadPool::GLOBAL().queueWorkItem(new NavPathWorkItem(job));
+   }
+}
+
+void NavMesh::cancelPathJobs()
+{
+   while(pathJobsRunning())
+      Platform::sleep(1);
+   updatePathJobs();
+
+   // The rest never started, and their navmesh is about to go away.
+   Vector<ThreadSafeRef<NavPathJob> > jobs = mPathJobs;
+   mPathJobs.clear();
+   for(U32 i = 0; i < jobs.size(); i++)
+   {
+      NavPathJob *job = jobs[i];
+      releaseQuery(job->query);
+      job->query = NULL;
+      job->status = DT_FAILURE;
+      completePathJob(job);
+   }
+}
+
+//-----------------------------------------------------------------------------
+// Batch planning
+//-----------------------------------------------------------------------------
+
+/// Number of paths each thread plans at a time in planPaths.
+static const U32 PathsPerBatch = 16;
+/// Maximum number of polygons in a path planned by planPaths.
+static const U32 BatchPathLen = 2048;
+
+void NavPathBatch::run(dtNavMeshQuery *query, U32 start, U32 end)
+{
+   dtPolyRef path[BatchPathLen];
+   F32 straightPath[BatchPathLen * 3];
+   dtPolyRef straightPathPolys[BatchPathLen];
+   U8 straightPathFlags[BatchPathLen];
+
+   for(U32 i = start; i < end; i++)
+   {
+      NavMesh::PathResult &r = results[i];
+      const dtPolyRef startRef = refs[startIdx[i]];
+      const dtPolyRef endRef = refs[endIdx[i]];
+      if(!startRef || !endRef)
+         continue;
+
+      const Point3F from = DTStoRC(this->from[i]);
+      const Point3F to = DTStoRC(this->to[i]);
+      const dtPolyRef *corridor = path;
+      S32 pathLen = 0;
+      if(cached[i].size())
+      {
+         corridor = cached[i].address();
+         pathLen = cached[i].size();
+      }
+      else
+      {
+         dtStatus status = query->findPath(startRef, endRef, from, to, &filter, path, &pathLen, BatchPathLen);
+         if(dtStatusFailed(status) || !pathLen)
+            continue;
+         r.partial = dtStatusDetail(status, DT_PARTIAL_RESULT);
+         if(!r.partial)
+         {
+            found[i].setSize(pathLen);
+            dMemcpy(found[i].address(), path, pathLen * sizeof(dtPolyRef));
+         }
+      }
+
+      S32 straightPathLen = 0;
+      query->findStraightPath(from, to, corridor, pathLen,
+         straightPath, straightPathFlags,
+         straightPathPolys, &straightPathLen, BatchPathLen);
+
+      const dtNavMesh *mesh = query->getAttachedNavMesh();
+      r.points.reserve(straightPathLen);
+      r.flags.reserve(straightPathLen);
+      for(U32 j = 0; j < straightPathLen; j++)
+      {
+         Point3F p = RCtoDTS(straightPath + j * 3);
+         U16 f = 0;
+         mesh->getPolyFlags(straightPathPolys[j], &f);
+         if(r.points.size())
+            r.length += (p - r.points.last()).len();
+         r.points.push_back(p);
+         r.flags.push_back(f);
+      }
+      r.success = !r.partial;
+   }
+}
+
+/// Runs part of a NavPathBatch on a ThreadPool thread.
+class NavPathBatchWorkItem : public ThreadPool::WorkItem
+{
+public:
+   NavPathBatchWorkItem(NavPathBatch *batch, dtNavMeshQuery *query, U32 start, U32 end)
+      : mBatch(batch), mQuery(query), mStart(start), mEnd(end) {}
+
+protected:
+   virtual void execute()
+   {
+      mBatch->run(mQuery, mStart, mEnd);
+      dFetchAndAdd(mBatch->done, 1);
+   }
+
+   ThreadSafeRef<NavPathBatch> mBatch;
+   dtNavMeshQuery *mQuery;
+   U32 mStart, mEnd;
+};
+
+/// An endpoint of a path in a batch, for finding duplicates.
+struct NavBatchPoint {
+   Point3F pos;
+   /// Path index * 2, plus 1 for goals.
+   U32 idx;
+};
+
+static S32 QSORT_CALLBACK compareBatchPoints(const void *a, const void *b)
+{
+   const Point3F &pa = ((const NavBatchPoint*)a)->pos;
+   const Point3F &pb = ((const NavBatchPoint*)b)->pos;
+   if(pa.x != pb.x) return pa.x < pb.x ? -1 : 1;
+   if(pa.y != pb.y) return pa.y < pb.y ? -1 : 1;
+   if(pa.z != pb.z) return pa.z < pb.z ? -1 : 1;
+   return 0;
+}
+
+U32 NavMesh::planPaths(const Vector<Point3F> &from, const Vector<Point3F> &to,
+                       const dtQueryFilter &filter, bool notifyScript)
+{
+   PROFILE_SCOPE(NavMesh_planPaths);
+
+   NavPathBatch *batch = new NavPathBatch();
+   ThreadSafeRef<NavPathBatch> ref(batch);
+   batch->id = ++mPathBatchId;
+   if(!batch->id)
+      batch->id = ++mPathBatchId;
+   batch->notifyScript = notifyScript;
+   batch->filter = filter;
+   // Even a batch with nothing to plan is delivered, on the next tick.
+   mPathBatches.push_back(ref);
+
+   const U32 n = getMin(from.size(), to.size());
+   batch->from = from;
+   batch->to = to;
+   batch->from.setSize(n);
+   batch->to.setSize(n);
+   batch->results.setSize(n);
+   for(U32 i = 0; i < n; i++)
+   {
+      batch->results[i].length = 0.0f;
+      batch->results[i].success = false;
+      batch->results[i].partial = false;
+   }
+   batch->cached.setSize(n);
+   batch->found.setSize(n);
+   batch->startIdx.setSize(n);
+   batch->endIdx.setSize(n);
+   if(!n)
+      return batch->id;
+
+   batch->snapshot = acquireSnapshot();
+   if(batch->snapshot.isNull())
+      return batch->id;
+   const dtNavMesh *mesh = batch->snapshot->nm;
+
+   // Agents often share a start or goal, so sort the endpoints and look up
+   // each distinct one once.
+   Vector<NavBatchPoint> points;
+   points.setSize(n * 2);
+   for(U32 i = 0; i < n; i++)
+   {
+      points[i*2].pos = from[i];
+      points[i*2].idx = i*2;
+      points[i*2+1].pos = to[i];
+      points[i*2+1].idx = i*2+1;
+   }
+   dQsort(points.address(), points.size(), sizeof(NavBatchPoint), compareBatchPoints);
+
+   dtNavMeshQuery *query = acquireQuery();
+   if(!query)
+      return batch->id;
+   query->init(mesh, query->getNodePool()->getMaxNodes());
+   const F32 extents[] = {mWalkableRadius * 4.0f, mWalkableHeight, mWalkableRadius * 4.0f};
+   for(U32 i = 0; i < points.size(); i++)
+   {
+      if(!i || compareBatchPoints(&points[i-1], &points[i]))
+      {
+         const Point3F p = DTStoRC(points[i].pos);
+         dtPolyRef ref = 0;
+         query->findNearestPoly(p, extents, &filter, &ref, NULL);
+         batch->refs.push_back(ref);
+      }
+      const U32 path = points[i].idx / 2;
+      if(points[i].idx & 1)
+         batch->endIdx[path] = batch->refs.size() - 1;
+      else
+         batch->startIdx[path] = batch->refs.size() - 1;
+   }
+
+   // Our snapshot is current, so cached corridors are valid in it. They're
+   // copied, since the cache may change before the workers get to them.
+   for(U32 i = 0; i < n; i++)
+   {
+      const dtPolyRef startRef = batch->refs[batch->startIdx[i]];
+      const dtPolyRef endRef = batch->refs[batch->endIdx[i]];
+      const Vector<dtPolyRef> *cached = startRef && endRef ? findCorridor(startRef, endRef, filter) : NULL;
+      if(cached)
+         batch->cached[i] = *cached;
+      // No path can exist, so don't search for one.
+      else if(startRef && endRef && !canReach(startRef, endRef, filter))
+         batch->startIdx[i] = batch->endIdx[i] = batch->refs.size();
+   }
+   // Unreachable paths point at this.
+   batch->refs.push_back(0);
+
+   // Hand every set of paths to the thread pool; updatePathBatches collects
+   // the results once they're all done.
+   for(U32 start = 0; start < n; start += PathsPerBatch)
+   {
+      const U32 end = getMin(start + PathsPerBatch, n);
+      dtNavMeshQuery *q = acquireQuery();
+      if(!q)
+      {
+         batch->run(query, start, end);
+         continue;
+      }
+      q->init(mesh, q->getNodePool()->getMaxNodes());
+      // Landmarks may be rebuilt while the workers run.
+      q->setHeuristic(NULL);
+      batch->queries.push_back(q);
+      batch->queued++;
+      ThreadPool::GLOBAL().queueWorkItem(new NavPathBatchWorkItem(batch, q, start, end));
+   }
+   releaseQuery(query);
+
+   return batch->id;
+}
+
+bool NavMesh::pathBatchesRunning() const
+{
+   for(U32 i = 0; i < mPathBatches.size(); i++)
+   {
+      NavPathBatch *batch = mPathBatches[i];
+      if(dAtomicRead(batch->done) < batch->queued)
+         return true;
+   }
+   return false;
+}
+
+void NavMesh::updatePathBatches()
+{
+   for(U32 i = 0; i < mPathBatches.size();)
+   {
+      ThreadSafeRef<NavPathBatch> batch = mPathBatches[i];
+      if(dAtomicRead(batch->done) < batch->queued)
+      {
+         i++;
+         continue;
+      }
+      // Listeners may plan more batches, so take this one out first.
+      mPathBatches.erase(i);
+      completePathBatch(batch);
+   }
+}
+
+void NavMesh::completePathBatch(NavPathBatch *batch)
+{
+   for(U32 i = 0; i < batch->queries.size(); i++)
+      releaseQuery(batch->queries[i]);
+   batch->queries.clear();
+
+   // Only cache corridors that are still valid in our mesh.
+   NavMeshSnapshot *snapshot = batch->snapshot;
+   if(snapshot && snapshot->meshVersion == mMeshVersion && snapshot->tileVersion == mTileVersion)
+   {
+      for(U32 i = 0; i < batch->found.size(); i++)
+      {
+         if(batch->found[i].size())
+            cacheCorridor(batch->refs[batch->startIdx[i]], batch->refs[batch->endIdx[i]],
+               batch->filter, batch->found[i].address(), batch->found[i].size());
+      }
+   }
+   releaseSnapshot(snapshot);
+   batch->snapshot = NULL;
+
+   mPathsPlannedSignal.trigger(this, batch->id, batch->results);
+
+   if(batch->notifyScript)
+   {
+      String out;
+      for(U32 i = 0; i < batch->results.size(); i++)
+      {
+         if(i)
+            out += "\n";
+         const PathResult &result = batch->results[i];
+         if(!result.success)
+            continue;
+         for(U32 j = 0; j < result.points.size(); j++)
+         {
+            const Point3F &p = result.points[j];
+            if(j)
+               out += "\t";
+            out += String::ToString("%g %g %g", p.x, p.y, p.z);
+         }
+      }
+      Con::executef(this, "onPathsPlanned", Con::getIntArg(batch->id), out.c_str());
+   }
+}
+
+void NavMesh::cancelPathBatches()
+{
+   // Workers hold queries leased from us, so wait for them.
+   while(pathBatchesRunning())
+      Platform::sleep(1);
+   updatePathBatches();
+}
+
+DefineEngineMethod(NavMesh, planPaths, S32, (String paths, U32 flags), (WalkFlag),
+   "Plan many paths at once on worker threads, without creating NavPath objects.\n\n"
+   "When the paths are done, onPathsPlanned(%this, %id, %paths) is called on this NavMesh "
+   "with one line per path in the order given, each a tab-separated list of the path's "
+   "points, or empty if no complete path was found.\n\n"
+   "@param paths One path per line, each given as its start and goal, \"x y z x y z\". "
+   "Lines that aren't are skipped.\n"
+   "@param flags The link types the paths may use.\n"
+   "@return ID of the batch, passed to onPathsPlanned.")
+{
+   Vector<Point3F> from, to;
+   S32 line = 0;
+   for(const char *p = paths.c_str(); p && *p; line++)
+   {
+      Point3F f, t;
+      if(dSscanf(p, "%g %g %g %g %g %g", &f.x, &f.y, &f.z, &t.x, &t.y, &t.z) == 6)
+      {
+         from.push_back(f);
+         to.push_back(t);
+      }
+      else
+         Con::warnf("NavMesh::planPaths: line %d is not a start and goal point.", line);
+      p = dStrchr(p, '\n');
+      if(p)
+         p++;
+   }
+
+   dtQueryFilter filter;
+   filter.setIncludeFlags(flags);
+   return object->planPaths(from, to, filter, true);
+}
+
+//-----------------------------------------------------------------------------
+// Path cache
+//-----------------------------------------------------------------------------
+
+const Vector<dtPolyRef> *NavMesh::findCorridor(dtPolyRef start, dtPolyRef end, const dtQueryFilter &filter)
+{
+   for(U32 i = 0; i < mPathCache.size(); i++)
+   {
+      CachedCorridor &c = mPathCache[i];
+      if(c.start == start && c.end == end &&
+         c.includeFlags == filter.getIncludeFlags() &&
+         c.excludeFlags == filter.getExcludeFlags())
+      {
+         c.lastUsed = ++mPathCacheClock;
+         return &c.polys;
+      }
+   }
+   return NULL;
+}
+
+void NavMesh::cacheCorridor(dtPolyRef start, dtPolyRef end, const dtQueryFilter &filter,
+                            const dtPolyRef *polys, U32 count)
+{
+   if(mPathCacheSize <= 0 || !count || !nm || findCorridor(start, end, filter))
+      return;
+
+   // Replace the least recently used entry once we're full.
+   CachedCorridor *c;
+   if(mPathCache.size() < mPathCacheSize)
+   {
+      mPathCache.increment();
+      c = &mPathCache.last();
+   }
+   else
+   {
+      c = &mPathCache[0];
+      for(U32 i = 1; i < mPathCache.size(); i++)
+         if(mPathCache[i].lastUsed < c->lastUsed)
+            c = &mPathCache[i];
+   }
+
+   c->start = start;
+   c->end = end;
+   c->includeFlags = filter.getIncludeFlags();
+   c->excludeFlags = filter.getExcludeFlags();
+   c->polys.setSize(count);
+   dMemcpy(c->polys.address(), polys, count * sizeof(dtPolyRef));
+   c->lastUsed = ++mPathCacheClock;
+
+   c->tiles.clear();
+   for(U32 i = 0; i < count; i++)
+   {
+      const dtMeshTile *tile;
+      const dtPoly *poly;
+      if(dtStatusFailed(nm->getTileAndPolyByRef(polys[i], &tile, &poly)))
+         continue;
+      const U32 key = (tile->header->x << 16) | (tile->header->y & 0xffff);
+      if(!c->tiles.contains(key))
+         c->tiles.push_back(key);
+   }
+}
+
+void NavMesh::invalidateCorridors(S32 x, S32 y)
+{
+   const U32 key = (x << 16) | (y & 0xffff);
+   for(U32 i = 0; i < mPathCache.size();)
+   {
+      if(mPathCache[i].tiles.contains(key))
+         mPathCache.erase_fast(i);
+      else
+         i++;
+   }
+}
+
+//-----------------------------------------------------------------------------
+// Connectivity
+//-----------------------------------------------------------------------------
+
+bool NavMesh::canReach(dtPolyRef from, dtPolyRef to, const dtQueryFilter &filter)
+{
+   if(!nm)
+      return true;
+
+   NavMeshConnectivity *c = NULL;
+   for(U32 i = 0; i < mConnectivity.size(); i++)
+   {
+      if(mConnectivity[i].includeFlags == filter.getIncludeFlags() &&
+         mConnectivity[i].excludeFlags == filter.getExcludeFlags())
+      {
+         c = &mConnectivity[i];
+         break;
+      }
+   }
+   if(!c)
+   {
+      // Forget the oldest class if there are too many.
+      if(mConnectivity.size() >= MaxConnectivityClasses)
+         mConnectivity.erase(U32(0));
+      mConnectivity.increment();
+      c = &mConnectivity.last();
+      c->build(nm, filter);
+      c->meshVersion = mMeshVersion;
+      c->tileVersion = mTileVersion;
+   }
+   else if(c->meshVersion != mMeshVersion || c->tileVersion != mTileVersion)
+   {
+      c->build(nm, filter);
+      c->meshVersion = mMeshVersion;
+      c->tileVersion = mTileVersion;
+   }
+
+   return c->canReach(nm, from, to);
+}
+
+void NavMesh::updateConnectivity()
+{
+   if(!nm)
+      return;
+   for(U32 i = 0; i < mConnectivity.size(); i++)
+   {
+      NavMeshConnectivity &c = mConnectivity[i];
+      if(c.meshVersion == mMeshVersion && c.tileVersion == mTileVersion)
+         continue;
+      dtQueryFilter filter;
+      filter.setIncludeFlags(c.includeFlags);
+      filter.setExcludeFlags(c.excludeFlags);
+      c.build(nm, filter);
+      c.meshVersion = mMeshVersion;
+      c.tileVersion = mTileVersion;
+   }
+}
+
+//-----------------------------------------------------------------------------
+// Search heuristic
+//-----------------------------------------------------------------------------
+
+/// Builds landmarks on a ThreadPool thread.
+class NavLandmarkWorkItem : public ThreadPool::WorkItem
+{
+public:
+   NavLandmarkWorkItem(NavLandmarkJob *job) : mJob(job) {}
+
+protected:
+   virtual void execute()
+   {
+      mJob->landmarks.build(mJob->snapshot->nm, mJob->count);
+      dCompareAndSwap(mJob->done, 0, 1);
+   }
+
+   ThreadSafeRef<NavLandmarkJob> mJob;
+};
+
+const dtQueryHeuristic *NavMesh::getHeuristic()
+{
+   if(mLandmarkCount <= 0 || !nm || mBuilding)
+      return NULL;
+
+   updateLandmarks();
+   if(mLandmarks.meshVersion == mMeshVersion &&
+      mLandmarks.tileVersion == mTileVersion &&
+      (S32)mLandmarks.size() <= mLandmarkCount)
+      return mLandmarks.size() ? &mLandmarks : NULL;
+
+   // Costs from before a tile changed may no longer be a lower bound, so
+   // don't use them while new ones are built.
+   const U32 now = Platform::getRealMilliseconds();
+   if(!mLandmarkJob.isNull() || (mLandmarks.size() && now - mLandmarkTime < LandmarkRefreshMS))
+      return NULL;
+
+   NavLandmarkJob *job = new NavLandmarkJob();
+   mLandmarkJob = job;
+   job->snapshot = acquireSnapshot();
+   if(job->snapshot.isNull())
+   {
+      mLandmarkJob = NULL;
+      return NULL;
+   }
+   job->count = mLandmarkCount;
+   mLandmarkTime = now;
+   ThreadPool::GLOBAL().queueWorkItem(new NavLandmarkWorkItem(job));
+   return NULL;
+}
+
+void NavMesh::updateLandmarks()
+{
+   if(mLandmarkJob.isNull() || !dAtomicRead(mLandmarkJob->done))
+      return;
+
+   ThreadSafeRef<NavLandmarkJob> job = mLandmarkJob;
+   mLandmarkJob = NULL;
+   NavMeshSnapshot *snapshot = job->snapshot;
+   // Polygon refs in a snapshot are the same as ours, so its landmarks
+   // work on our mesh too, unless the whole mesh has been replaced.
+   if(snapshot->meshVersion == mMeshVersion)
+   {
+      mLandmarks = job->landmarks;
+      mLandmarks.setMesh(nm);
+      mLandmarks.meshVersion = snapshot->meshVersion;
+      mLandmarks.tileVersion = snapshot->tileVersion;
+   }
+   releaseSnapshot(snapshot);
+   job->snapshot = NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+// Hierarchical planning
+//-----------------------------------------------------------------------------
+
+void NavMesh::updateHierarchy()
+{
+   if(mHierarchyTiles <= 0 || !nm || mHierarchy.isReady())
+      return;
+
+   dtNavMeshQuery *query = acquireQuery();
+   if(!query)
+      return;
+   mHierarchy.update(nm, query, HierarchyTilesPerTick);
+   releaseQuery(query);
+}
+
+bool NavMesh::findHierarchicalRoute(dtPolyRef startRef, dtPolyRef endRef,
+                                    const F32 *from, const F32 *to,
+                                    const dtQueryFilter &filter,
+                                    Vector<dtPolyRef> &refs, Vector<Point3F> &points)
+{
+   // Until the graph is complete we can't tell a missing route from an
+   // unbuilt one.
+   if(mHierarchyTiles <= 0 || !nm || !mHierarchy.isReady())
+      return false;
+
+   const dtMeshTile *start, *end;
+   const dtPoly *poly;
+   if(dtStatusFailed(nm->getTileAndPolyByRef(startRef, &start, &poly)) ||
+      dtStatusFailed(nm->getTileAndPolyByRef(endRef, &end, &poly)))
+      return false;
+   if(mAbs(start->header->x - end->header->x) < mHierarchyTiles &&
+      mAbs(start->header->y - end->header->y) < mHierarchyTiles)
+      return false;
+
+   return mHierarchy.findRoute(nm, startRef, endRef, from, to, filter, refs, points);
+}
+
+void NavMesh::freeQueries()
+{
+   MutexHandle lock;
+   lock.lock(&mQueryMutex);
+   for(U32 i = 0; i < mQueryPool.size(); i++)
+      dtFreeNavMeshQuery(mQueryPool[i].query);
+   mQueryPool.clear();
+}
+
+void NavMesh::updateObstacle(const Box3F &box, bool added)
+{
+   ObstacleUpdate u;
+   u.box = box;
+   u.added = added;
+   mObstacleUpdates.push_back(u);
+}
+
+void NavMesh::processObstacles()
+{
+   if(!mObstacleUpdates.size())
+      return;
+   if(!nm || !mTiles.size())
+   {
+      mObstacleUpdates.clear();
+      return;
+   }
+
+   // Several obstacles may have touched the same tile this tick; only carve
+   // each tile once.
+   Vector<bool> carve;
+   carve.setSize(mTiles.size());
+   carve.fill(false);
+   for(U32 u = 0; u < mObstacleUpdates.size(); u++)
+   {
+      const Box3F &box = mObstacleUpdates[u].box;
+      for(U32 i = 0; i < mTiles.size(); i++)
+      {
+         if(getObstacleBox(mTiles[i]).isOverlapped(box))
+            carve[i] = true;
+      }
+   }
+   // Tiles loaded from a file have no heightfield yet and must be rebuilt.
+   Vector<bool> rebuilt;
+   rebuilt.setSize(mTiles.size());
+   rebuilt.fill(false);
+   for(U32 i = 0; i < mTiles.size(); i++)
+   {
+      if(carve[i])
+         rebuilt[i] = !carveTile(i);
+   }
+
+   // Agents replan when they hear about an obstacle, so don't tell them
+   // until every tile it touches has actually been replaced.
+   for(U32 u = 0; u < mObstacleUpdates.size(); u++)
+   {
+      const ObstacleUpdate &update = mObstacleUpdates[u];
+      bool waiting = false;
+      for(U32 i = 0; i < mTiles.size() && !waiting; i++)
+         waiting = rebuilt[i] && getObstacleBox(mTiles[i]).isOverlapped(update.box);
+      if(waiting)
+         mObstacleEvents.push_back(update);
+      else if(getEventManager())
+      {
+         String str = String::ToString("%d %s", getId(), castConsoleTypeToString(update.box));
+         getEventManager()->postEvent(update.added ? "NavMeshObstacleAdded" : "NavMeshObstacleRemoved", str.c_str());
+      }
+   }
+   setMaskBits(LoadFlag);
+
+   mObstacleUpdates.clear();
+}
+
+void NavMesh::postObstacleEvents()
+{
+   if(getEventManager())
+   {
+      for(U32 u = 0; u < mObstacleEvents.size(); u++)
+      {
+         const ObstacleUpdate &update = mObstacleEvents[u];
+         String str = String::ToString("%d %s", getId(), castConsoleTypeToString(update.box));
+         getEventManager()->postEvent(update.added ? "NavMeshObstacleAdded" : "NavMeshObstacleRemoved", str.c_str());
+      }
+   }
+   mObstacleEvents.clear();
+}
+
+bool NavMesh::carveTile(U32 i)
+{
+   const Tile &tile = mTiles[i];
+   TileData &tdata = mTileData[i];
+   // Without a heightfield to carve, fall back to a full rebuild. That keeps
+   // the heightfield, so later obstacles here are carved directly.
+   if(!tdata.chf || !tdata.areas.size())
+   {
+      buildTile(i);
+      return false;
+   }
+   U32 dataSize = 0;
+   unsigned char *data = buildTileMesh(tile, tdata, dataSize);
+   // A NULL result means the obstacles left nothing walkable in this tile.
+   replaceTile(tile, data, dataSize);
+   if(!mSaveIntermediates)
+      tdata.freeMesh();
+   // Raycast cover follows the navmesh edges, which have just moved.
+   if(mCoverMethod == Raycast && mCover[i].valid)
+   {
+      cancelTileCover(i);
+      clearTileCover(i);
+      queueTileCover(i);
+   }
+   return true;
+}
+
+Box3F NavMesh::getObstacleBox(const Tile &tile) const
+{
+   const F32 expand = cfg.borderSize * cfg.cs + mWalkableRadius;
+   Box3F box = tile.box;
+   box.minExtents -= Point3F(expand, expand, 0.0f);
+   box.maxExtents += Point3F(expand, expand, 0.0f);
+   return box;
+}
+
+void NavMesh::markObstacles(const Tile &tile, rcCompactHeightfield &chf)
+{
+   const Box3F box = getObstacleBox(tile);
+   SimSet *set = NavObstacle::getServerSet();
+   for(U32 i = 0; i < set->size(); i++)
+   {
+      NavObstacle *o = static_cast<NavObstacle*>(set->at(i));
+      if(o->getWorldBox().isOverlapped(box))
+         o->carve(ctx, mWalkableRadius, mWalkableHeight, chf);
+   }
+}
+
+void NavMesh::deleteCoverPoints()
+{
+   cancelCover();
+   for(U32 i = 0; i < mCover.size(); i++)
+      clearTileCover(i);
+}
+
+DefineEngineMethod(NavMesh, deleteCoverPoints, void, (),,
+   "@brief Remove all cover points for this NavMesh.")
+{
+   object->deleteCoverPoints();
+}
+
+S32 NavMesh::getTileIndex(U32 x, U32 y) const
+{
+   // updateTiles creates tiles row by row.
+   if(x >= mTilesX || y >= mTilesY)
+      return -1;
+   return y * mTilesX + x;
+}
+
+//-----------------------------------------------------------------------------
+// Cover storage
+//-----------------------------------------------------------------------------
+
+/// Cover references pack a 32-bit tile generation, a 20-bit tile index and
+/// a 12-bit point index.
+static const U32 CoverTileBits = 20;
+static const U32 CoverIndexBits = 12;
+static const U32 MaxCoverTiles = 1 << CoverTileBits;
+static const U32 MaxTileCover = 1 << CoverIndexBits;
+
+static inline NavMesh::CoverRef makeCoverRef(U32 gen, U32 tile, U32 idx)
+{
+   return ((NavMesh::CoverRef)gen << (CoverTileBits + CoverIndexBits)) |
+          (tile << CoverIndexBits) | idx;
+}
+
+const char *NavMesh::getCoverRefString(CoverRef ref)
+{
+   if(ref == NullCover)
+      return "-1";
+   char *buf = Con::getReturnBuffer(32);
+   dSprintf(buf, 32, "%llu", (unsigned long long)ref);
+   return buf;
+}
+
+NavMesh::CoverRef NavMesh::getCoverRefFromString(const char *str)
+{
+   unsigned long long ref;
+   if(!str || str[0] == '-' || dSscanf(str, "%llu", &ref) != 1)
+      return NullCover;
+   return ref;
+}
+
+/// Read a cover point's occupancy flag.
+static inline bool isOccupied(const U32 &flag)
+{
+   return dAtomicRead(const_cast<U32&>(flag)) != 0;
+}
+
+void NavMesh::TileCover::set(const Vector<CoverPointData> &points)
+{
+   clear();
+   const U32 n = getMin(points.size(), MaxTileCover);
+   px.setSize(n); py.setSize(n); pz.setSize(n);
+   nx.setSize(n); ny.setSize(n); nz.setSize(n);
+   size.setSize(n);
+   peek.setSize(n);
+   quality.setSize(n);
+   occupied.setSize(n);
+   for(U32 i = 0; i < n; i++)
+   {
+      const CoverPointData &p = points[i];
+      const Point3F pos = p.trans.getPosition();
+      const VectorF normal = p.trans.getForwardVector();
+      px[i] = pos.x; py[i] = pos.y; pz[i] = pos.z;
+      nx[i] = normal.x; ny[i] = normal.y; nz[i] = normal.z;
+      size[i] = p.size;
+      peek[i] = (p.peek[0] ? PeekLeft : 0) |
+                (p.peek[1] ? PeekRight : 0) |
+                (p.peek[2] ? PeekOver : 0);
+      quality[i] = 1.0f;
+      occupied[i] = 0;
+   }
+   generated = n;
+}
+
+void NavMesh::TileCover::clear()
+{
+   px.clear(); py.clear(); pz.clear();
+   nx.clear(); ny.clear(); nz.clear();
+   size.clear();
+   peek.clear();
+   quality.clear();
+   occupied.clear();
+   valid = false;
+   generated = 0;
+}
+
+void NavMesh::TileCover::truncate(U32 n)
+{
+   if(n >= count())
+      return;
+   px.setSize(n); py.setSize(n); pz.setSize(n);
+   nx.setSize(n); ny.setSize(n); nz.setSize(n);
+   size.setSize(n);
+   peek.setSize(n);
+   quality.setSize(n);
+   occupied.setSize(n);
+   generated = getMin(generated, n);
+}
+
+void NavMesh::setTileCover(U32 tile, const Vector<CoverPointData> &points)
+{
+   if(tile >= mCover.size())
+      return;
+   // Tiles past this can't be referenced.
+   if(tile >= MaxCoverTiles)
+   {
+      Con::warnf("NavMesh %d: tile %d is past the last tile that can hold cover (%d).",
+         getId(), tile, MaxCoverTiles - 1);
+      return;
+   }
+   if(points.size() > MaxTileCover)
+      Con::warnf("NavMesh %d: tile %d has %d cover points, only keeping %d.",
+         getId(), tile, points.size(), MaxTileCover);
+   mCover[tile].set(points);
+   mCover[tile].valid = true;
+   importCoverPoints(tile);
+   updateCoverProxies(tile);
+}
+
+void NavMesh::clearTileCover(U32 tile)
+{
+   if(tile >= mCover.size())
+      return;
+   mCover[tile].clear();
+   importCoverPoints(tile);
+   updateCoverProxies(tile);
+}
+
+static void findCoverPointsCallback(SceneObject *obj, void *key)
+{
+   CoverPoint *p = dynamic_cast<CoverPoint*>(obj);
+   // Our own display proxies aren't saved with the mission.
+   if(p && p->getCanSave())
+      static_cast<Vector<CoverPoint*>*>(key)->push_back(p);
+}
+
+void NavMesh::importCoverPoints(U32 tile)
+{
+   if(tile >= mCover.size())
+      return;
+   TileCover &c = mCover[tile];
+   // References to the old imported points must not find the new ones.
+   c.generation = ++mCoverGeneration;
+   c.truncate(c.generated);
+   if(!isServerObject() || tile >= MaxCoverTiles || !getContainer())
+      return;
+
+   Vector<CoverPoint*> points;
+   getContainer()->findObjects(mTiles[tile].box, MarkerObjectType, findCoverPointsCallback, &points);
+   for(U32 i = 0; i < points.size(); i++)
+   {
+      const CoverPoint *p = points[i];
+      const Point3F pos = p->getPosition();
+      // A point on the edge between two tiles only belongs to one of them.
+      U32 x0, y0, x1, y1;
+      if(!getTileRange(Box3F(pos, pos), x0, y0, x1, y1) || getTileIndex(x0, y0) != (S32)tile)
+         continue;
+      if(c.count() >= MaxTileCover)
+      {
+         Con::warnf("NavMesh %d: tile %d is full, ignoring CoverPoint %d.",
+            getId(), tile, p->getId());
+         continue;
+      }
+      const VectorF normal = p->getNormal();
+      c.px.push_back(pos.x); c.py.push_back(pos.y); c.pz.push_back(pos.z);
+      c.nx.push_back(normal.x); c.ny.push_back(normal.y); c.nz.push_back(normal.z);
+      c.size.push_back(p->getSize());
+      c.peek.push_back((p->peekLeft() ? PeekLeft : 0) |
+                       (p->peekRight() ? PeekRight : 0) |
+                       (p->peekOver() ? PeekOver : 0));
+      c.quality.push_back(p->getQuality());
+      c.occupied.push_back(0);
+   }
+}
+
+void NavMesh::updateCoverPoints(const Box3F &box)
+{
+   U32 x0, y0, x1, y1;
+   if(!getTileRange(box, x0, y0, x1, y1))
+      return;
+   for(U32 y = y0; y <= y1; y++)
+   {
+      for(U32 x = x0; x <= x1; x++)
+         importCoverPoints(getTileIndex(x, y));
+   }
+}
+
+bool NavMesh::getCoverIndex(CoverRef ref, U32 &tile, U32 &idx) const
+{
+   if(ref == NullCover)
+      return false;
+   tile = (ref >> CoverIndexBits) & (MaxCoverTiles - 1);
+   idx = ref & (MaxTileCover - 1);
+   if(tile >= mCover.size())
+      return false;
+   const TileCover &c = mCover[tile];
+   const U32 gen = ref >> (CoverTileBits + CoverIndexBits);
+   return gen == c.generation && idx < c.count();
+}
+
+bool NavMesh::isCoverValid(CoverRef ref) const
+{
+   U32 tile, idx;
+   return getCoverIndex(ref, tile, idx);
+}
+
+U32 NavMesh::getCoverCount() const
+{
+   U32 count = 0;
+   for(U32 i = 0; i < mCover.size(); i++)
+      count += mCover[i].count();
+   return count;
+}
+
+Point3F NavMesh::getCoverPosition(CoverRef ref) const
+{
+   U32 tile, idx;
+   if(!getCoverIndex(ref, tile, idx))
+      return Point3F::Zero;
+   const TileCover &c = mCover[tile];
+   return Point3F(c.px[idx], c.py[idx], c.pz[idx]);
+}
+
+VectorF NavMesh::getCoverNormal(CoverRef ref) const
+{
+   U32 tile, idx;
+   if(!getCoverIndex(ref, tile, idx))
+      return VectorF::Zero;
+   const TileCover &c = mCover[tile];
+   return VectorF(c.nx[idx], c.ny[idx], c.nz[idx]);
+}
+
+CoverPoint::Size NavMesh::getCoverSize(CoverRef ref) const
+{
+   U32 tile, idx;
+   if(!getCoverIndex(ref, tile, idx))
+      return CoverPoint::Prone;
+   return (CoverPoint::Size)mCover[tile].size[idx];
+}
+
+void NavMesh::getCoverPeek(CoverRef ref, bool &left, bool &right, bool &over) const
+{
+   left = right = over = false;
+   U32 tile, idx;
+   if(!getCoverIndex(ref, tile, idx))
+      return;
+   const U8 peek = mCover[tile].peek[idx];
+   left = peek & PeekLeft;
+   right = peek & PeekRight;
+   over = peek & PeekOver;
+}
+
+bool NavMesh::isCoverOccupied(CoverRef ref) const
+{
+   U32 tile, idx;
+   if(!getCoverIndex(ref, tile, idx))
+      return false;
+   return isOccupied(mCover[tile].occupied[idx]);
+}
+
+bool NavMesh::setCoverOccupied(CoverRef ref, bool occupied)
+{
+   U32 tile, idx;
+   if(!getCoverIndex(ref, tile, idx))
+      return false;
+   const U32 val = occupied ? 1 : 0;
+   dCompareAndSwap(mCover[tile].occupied[idx], 1 - val, val);
+   return true;
+}
+
+bool NavMesh::reserveCover(CoverRef ref)
+{
+   U32 tile, idx;
+   if(!getCoverIndex(ref, tile, idx))
+      return false;
+   return dCompareAndSwap(mCover[tile].occupied[idx], 0, 1);
+}
+
+NavMesh::CoverRef NavMesh::findCover(const Point3F &loc, const Point3F &from, F32 radius, bool reserve)
+{
+   if(radius <= 0.0f)
+      return NullCover;
+
+   Box3F box(loc - Point3F(radius, radius, radius),
+             loc + Point3F(radius, radius, radius));
+   U32 x0, y0, x1, y1;
+   if(!getTileRange(box, x0, y0, x1, y1))
+      return NullCover;
+
+   const F32 radiusSq = radius * radius;
+   const F32 invRadius = 1.0f / radius;
+   const F32 invSizes = 1.0f / CoverPoint::NumSizes;
+
+   // Another search may take our best point before we can reserve it, in
+   // which case it will be skipped as occupied the next time around.
+   for(U32 attempt = 0; attempt < 8; attempt++)
+   {
+      CoverRef best = NullCover;
+      F32 bestScore = -F32_MAX;
+      for(U32 y = y0; y <= y1; y++)
+      {
+         for(U32 x = x0; x <= x1; x++)
+         {
+            const U32 t = y * mTilesX + x;
+            const TileCover &c = mCover[t];
+            const U32 n = c.count();
+            // Score points in chunks. The first loop has no branches, so the
+            // compiler is free to vectorise it.
+            const U32 Chunk = 64;
+            F32 scores[Chunk];
+            for(U32 base = 0; base < n; base += Chunk)
+            {
+               const U32 end = getMin(n - base, Chunk);
+               const F32 *px = c.px.address() + base;
+               const F32 *py = c.py.address() + base;
+               const F32 *pz = c.pz.address() + base;
+               const F32 *nx = c.nx.address() + base;
+               const F32 *ny = c.ny.address() + base;
+               const F32 *nz = c.nz.address() + base;
+               const U8 *size = c.size.address() + base;
+               const F32 *quality = c.quality.address() + base;
+               for(U32 i = 0; i < end; i++)
+               {
+                  const F32 lx = px[i] - loc.x, ly = py[i] - loc.y, lz = pz[i] - loc.z;
+                  const F32 distSq = lx*lx + ly*ly + lz*lz;
+                  const F32 fx = from.x - px[i], fy = from.y - py[i], fz = from.z - pz[i];
+                  const F32 fromLen = mSqrt(fx*fx + fy*fy + fz*fz) + POINT_EPSILON;
+                  // Prefer cover that faces the threat, is close by, and is
+                  // tall, then scale by how reliable the cover is.
+                  const F32 score = ((nx[i]*fx + ny[i]*fy + nz[i]*fz) / fromLen
+                     - mSqrt(distSq) * invRadius
+                     + (size[i] + 1) * invSizes) * quality[i];
+                  scores[i] = distSq <= radiusSq ? score : -F32_MAX;
+               }
+               for(U32 i = 0; i < end; i++)
+               {
+                  if(scores[i] > bestScore && !isOccupied(c.occupied[base + i]))
+                  {
+                     bestScore = scores[i];
+                     best = makeCoverRef(c.generation, t, base + i);
+                  }
+               }
+            }
+         }
+      }
+      if(best == NullCover || !reserve || reserveCover(best))
+         return best;
+   }
+   return NullCover;
+}
+
+void NavMesh::createCoverProxies()
+{
+   SimSet *set = NULL;
+   if(!Sim::findObject(mCoverSet, set))
+   {
+      set = new SimGroup();
+      if(set->registerObject(mCoverSet))
+      {
+         set->setCanSave(false);
+         getGroup()->addObject(set);
+      }
+      else
+      {
+         delete set;
+         set = getGroup();
+      }
+   }
+   mCoverProxies = set;
+
+   for(U32 t = 0; t < mCover.size(); t++)
+      updateCoverProxies(t);
+}
+
+void NavMesh::deleteCoverProxies()
+{
+   for(U32 t = 0; t < mCover.size(); t++)
+   {
+      Vector<SimObjectPtr<CoverPoint> > &proxies = mCover[t].proxies;
+      for(U32 i = 0; i < proxies.size(); i++)
+      {
+         if(!proxies[i].isNull())
+            proxies[i]->deleteObject();
+      }
+      proxies.clear();
+   }
+   mCoverProxies = NULL;
+}
+
+void NavMesh::updateCoverProxies(U32 tile)
+{
+   TileCover &c = mCover[tile];
+   for(U32 i = 0; i < c.proxies.size(); i++)
+   {
+      if(!c.proxies[i].isNull())
+         c.proxies[i]->deleteObject();
+   }
+   c.proxies.clear();
+
+   if(!mCoverProxies)
+      return;
+
+   // Imported points are displayed by their own CoverPoint objects.
+   for(U32 i = 0; i < c.generated; i++)
+   {
+      CoverPoint *m = new CoverPoint();
+      m->setCanSave(false);
+      if(!m->registerObject())
+      {
+         delete m;
+         continue;
+      }
+      MatrixF mat = MathUtils::createOrientFromDir(VectorF(c.nx[i], c.ny[i], c.nz[i]));
+      mat.setPosition(Point3F(c.px[i], c.py[i], c.pz[i]));
+      m->setTransform(mat);
+      m->setSize((CoverPoint::Size)c.size[i]);
+      m->setPeek(c.peek[i] & PeekLeft, c.peek[i] & PeekRight, c.peek[i] & PeekOver);
+      mCoverProxies->addObject(m);
+      c.proxies.push_back(m);
+   }
+}
+
+DefineEngineMethod(NavMesh, findCover, const char*, (Point3F loc, Point3F from, F32 radius),,
+   "@brief Find the best unoccupied cover point near a position.\n\n"
+   "@param loc    Position to search around.\n"
+   "@param from   Position to take cover from.\n"
+   "@param radius Distance to search.\n"
+   "@return A cover reference (a string of digits), or -1 if no cover was found.")
+{
+   return NavMesh::getCoverRefString(object->findCover(loc, from, radius));
+}
+
+DefineEngineMethod(NavMesh, getCoverCount, S32, (),,
+   "@brief Return the number of cover points in this NavMesh.")
+{
+   return object->getCoverCount();
+}
+
+DefineEngineMethod(NavMesh, getCoverPosition, Point3F, (const char *ref),,
+   "@brief Return the position of a cover point.")
+{
+   return object->getCoverPosition(NavMesh::getCoverRefFromString(ref));
+}
+
+DefineEngineMethod(NavMesh, getCoverNormal, Point3F, (const char *ref),,
+   "@brief Return the direction a cover point faces.")
+{
+   return object->getCoverNormal(NavMesh::getCoverRefFromString(ref));
+}
+
+DefineEngineMethod(NavMesh, getCoverSize, CoverPointSize, (const char *ref),,
+   "@brief Return the size of a cover point.")
+{
+   return object->getCoverSize(NavMesh::getCoverRefFromString(ref));
+}
+
+DefineEngineMethod(NavMesh, isCoverOccupied, bool, (const char *ref),,
+   "@brief Is a cover point in use?")
+{
+   return object->isCoverOccupied(NavMesh::getCoverRefFromString(ref));
+}
+
+DefineEngineMethod(NavMesh, reserveCover, bool, (const char *ref),,
+   "@brief Mark a cover point as in use.\n\n"
+   "@return False if the cover point was already in use or no longer exists.")
+{
+   return object->reserveCover(NavMesh::getCoverRefFromString(ref));
+}
+
+DefineEngineMethod(NavMesh, setCoverOccupied, bool, (const char *ref, bool occupied),,
+   "@brief Set whether a cover point is in use.\n\n"
+   "@return False if the cover point no longer exists.")
+{
+   return object->setCoverOccupied(NavMesh::getCoverRefFromString(ref), occupied);
+}
+
+//-----------------------------------------------------------------------------
+// Batched cover testing
+//-----------------------------------------------------------------------------
+
+/// Cover candidates for one tile, and a copy of the collision geometry around
+/// them. SceneContainer::castRay isn't thread-safe, so workers test against
+/// this snapshot instead.
+struct NavMesh::CoverBatch : public ThreadSafeRefCount<NavMesh::CoverBatch>
+{
+   /// Index of the tile these candidates came from.
+   U32 tile;
+   /// Collision geometry in Recast space.
+   RecastPolyList geom;
+   /// Recast-space bounds of each triangle.
+   Vector<Box3F> triBoxes;
+   /// Candidate positions along the navmesh edge.
+   Vector<Point3F> positions;
+   /// Edge direction at each candidate.
+   Vector<VectorF> edges;
+   /// Cover points found by the worker.
+   Vector<CoverPointData> results;
+
+   /// @name Settings
+   /// Copied from the NavMesh so workers never touch it.
+   /// @{
+   F32 walkableHeight;
+   F32 coverDist;
+   F32 peekDist;
+   bool innerCover;
+   /// @}
+
+   /// Set by the worker thread when results are ready.
+   volatile U32 done;
+
+   CoverBatch() : tile(0), done(0) {}
+
+   /// Does a segment hit any geometry in the snapshot?
+   bool castRay(const Point3F &start, const Point3F &end) const;
+
+   /// Attempt to place a cover point along a given edge.
+   bool testEdgeCover(const Point3F &pos, const VectorF &dir, CoverPointData &data) const;
+
+   /// Test every candidate.
+   void run();
+};
+
+/// Read a Recast-space vertex.
+static inline Point3F rcVert(const F32 *v)
+{
+   return Point3F(v[0], v[1], v[2]);
+}
+
+bool NavMesh::CoverBatch::castRay(const Point3F &start, const Point3F &end) const
+{
+   const Point3F s = DTStoRC(start);
+   const Point3F e = DTStoRC(end);
+   const Point3F d = e - s;
+   Box3F segBox(s, s);
+   segBox.extend(e);
+
+   const F32 *verts = geom.getVerts();
+   const S32 *tris = geom.getTris();
+   for(U32 t = 0; t < geom.getTriCount(); t++)
+   {
+      if(!triBoxes[t].isOverlapped(segBox))
+         continue;
+      // Moller-Trumbore, limited to the segment.
+      const Point3F v0 = rcVert(&verts[tris[t*3]*3]);
+      const Point3F e1 = rcVert(&verts[tris[t*3+1]*3]) - v0;
+      const Point3F e2 = rcVert(&verts[tris[t*3+2]*3]) - v0;
+      const Point3F p = mCross(d, e2);
+      const F32 det = mDot(e1, p);
+      if(mFabs(det) < 1e-8f)
+         continue;
+      const F32 inv = 1.0f / det;
+      const Point3F tv = s - v0;
+      const F32 u = mDot(tv, p) * inv;
+      if(u < 0.0f || u > 1.0f)
+         continue;
+      const Point3F q = mCross(tv, e1);
+      const F32 v = mDot(d, q) * inv;
+      if(v < 0.0f || u + v > 1.0f)
+         continue;
+      const F32 dist = mDot(e2, q) * inv;
+      if(dist >= 0.0f && dist <= 1.0f)
+         return true;
+   }
+   return false;
+}
+
+bool NavMesh::CoverBatch::testEdgeCover(const Point3F &pos, const VectorF &dir, CoverPointData &data) const
+{
+   data.peek[0] = data.peek[1] = data.peek[2] = false;
+   // Get the edge normal.
+   Point3F norm;
+   mCross(dir, Point3F(0, 0, 1), &norm);
+   U32 hits = 0;
+   for(U32 j = 0; j < CoverPoint::NumSizes; j++)
+   {
+      Point3F test = pos + Point3F(0.0f, 0.0f, walkableHeight * j / CoverPoint::NumSizes);
+      if(castRay(test, test + norm * coverDist))
+      {
+         // Test peeking.
+         Point3F left = test + dir * peekDist;
+         data.peek[0] = !castRay(test, left)
+            && !castRay(left, left + norm * coverDist);
+
+         Point3F right = test - dir * peekDist;
+         data.peek[1] = !castRay(test, right)
+            && !castRay(right, right + norm * coverDist);
+
+         Point3F over = test + Point3F(0, 0, 1) * 0.2f;
+         data.peek[2] = !castRay(test, over)
+            && !castRay(over, over + norm * coverDist);
+
+         if(innerCover || data.peek[0] || data.peek[1] || data.peek[2])
+            hits++;
+         // If we couldn't peek here, we may be able to peek further up.
+      }
+      else
+         // No cover at this height - break off.
+         break;
+   }
+   if(hits > 0)
+   {
+      data.size = (CoverPoint::Size)(hits - 1);
+      data.trans = MathUtils::createOrientFromDir(norm);
+      data.trans.setPosition(pos);
+   }
+   return hits > 0;
+}
+
+void NavMesh::CoverBatch::run()
+{
+   const F32 *verts = geom.getVerts();
+   const S32 *tris = geom.getTris();
+   triBoxes.setSize(geom.getTriCount());
+   for(U32 t = 0; t < geom.getTriCount(); t++)
+   {
+      Box3F &box = triBoxes[t];
+      box.minExtents = box.maxExtents = rcVert(&verts[tris[t*3]*3]);
+      box.extend(rcVert(&verts[tris[t*3+1]*3]));
+      box.extend(rcVert(&verts[tris[t*3+2]*3]));
+   }
+
+   for(U32 i = 0; i < positions.size(); i++)
+   {
+      CoverPointData data;
+      if(testEdgeCover(positions[i], edges[i], data))
+         results.push_back(data);
+   }
+
+   dCompareAndSwap(done, 0, 1);
+}
+
+/// Number of tiles updateCover gathers cover candidates and collision for
+/// each tick.
+static const U32 CoverTilesPerTick = 4;
+
+/// Runs a CoverBatch on a ThreadPool thread.
+class NavCoverWorkItem : public ThreadPool::WorkItem
+{
+public:
+   NavCoverWorkItem(NavMesh::CoverBatch *batch) : mBatch(batch) {}
+
+protected:
+   virtual void execute()
+   {
+      mBatch->run();
+   }
+
+   ThreadSafeRef<NavMesh::CoverBatch> mBatch;
+};
+
+bool NavMesh::createCoverPoints()
+{
+   if(!nm || !isServerObject())
+      return false;
+
+   cancelCover();
+
+   for(U32 t = 0; t < mTiles.size(); t++)
+   {
+      // Keep cover found in the voxel data when the tile was built. Tiles
+      // that were loaded from a file fall back to raycasting.
+      if(mCoverMethod == Voxels && mCover[t].valid)
+         continue;
+      queueTileCover(t);
+   }
+
+   // Everything came from voxel data, so we're already done.
+   if(!mCoverBatchCount && getEventManager())
+      getEventManager()->postEvent("NavMeshCoverUpdate", getIdString());
+   return true;
+}
+
+bool NavMesh::queueTileCover(U32 t)
+{
+   if(!nm || t >= mTiles.size())
+      return false;
+   if(!mCoverTiles.contains(t))
+   {
+      mCoverTiles.push_back(t);
+      mCoverBatchCount++;
+   }
+   return true;
+}
+
+bool NavMesh::startTileCover(U32 t, dtNavMeshQuery *query)
+{
+   if(!nm || t >= mTiles.size())
+      return false;
+
+   const dtMeshTile *tile = ((const dtNavMesh*)nm)->getTileAt(mTiles[t].x, mTiles[t].y, 0);
+   if(!tile || !tile->header)
+   {
+      setTileCover(t, Vector<CoverPointData>());
+      return false;
+   }
+
+   dtQueryFilter f;
+
+   // Collect candidate points along the walls of this tile.
+   CoverBatch *batch = new CoverBatch();
+   ThreadSafeRef<CoverBatch> batchRef(batch);
+   batch->tile = t;
+   const int MAX_SEGS = 6;
+   const dtPolyRef base = nm->getPolyRefBase(tile);
+   for(U32 j = 0; j < tile->header->polyCount; ++j)
+   {
+      const dtPolyRef ref = base | j;
+      float segs[MAX_SEGS*6];
+      int nsegs = 0;
+      query->getPolyWallSegments(ref, &f, segs, NULL, &nsegs, MAX_SEGS);
+      for(int j = 0; j < nsegs; ++j)
+      {
+         const float* sa = &segs[j*6];
+         const float* sb = &segs[j*6+3];
+         Point3F a = RCtoDTS(sa), b = RCtoDTS(sb);
+         F32 len = (b - a).len();
+         if(len < mWalkableRadius * 2)
+            continue;
+         Point3F edge = b - a;
+         edge.normalize();
+         // Number of points to try placing - for now, one at each end.
+         U32 pointCount = (len > mWalkableRadius * 4) ? 2 : 1;
+         for(U32 i = 0; i < pointCount; i++)
+         {
+            Point3F pos;
+            // If we're only placing one point, put it in the middle.
+            if(pointCount == 1)
+               pos = a + edge * len / 2;
+            // Otherwise, stand off from edge ends.
+            else
+            {
+               if(i % 2)
+                  pos = a + edge * (i/2+1) * mWalkableRadius;
+               else
+                  pos = b - edge * (i/2+1) * mWalkableRadius;
+            }
+            batch->positions.push_back(pos);
+            batch->edges.push_back(edge);
+         }
+      }
+   }
+   if(!batch->positions.size())
+   {
+      setTileCover(t, batch->results);
+      return false;
+   }
+
+   // Snapshot the collision our rays could reach.
+   Box3F box = RCtoDTS(tile->header->bmin, tile->header->bmax);
+   const F32 reach = mCoverDist + mPeekDist;
+   box.minExtents -= Point3F(reach, reach, 0.0f);
+   box.maxExtents += Point3F(reach, reach, mWalkableHeight + 0.2f);
+   SceneContainer::CallbackInfo info;
+   info.context = PLC_Collision;
+   info.boundingBox = box;
+   info.polyList = &batch->geom;
+   info.key = this;
+   getContainer()->findObjects(box, StaticObjectType, buildCallback, &info);
+
+   batch->walkableHeight = mWalkableHeight;
+   batch->coverDist = mCoverDist;
+   batch->peekDist = mPeekDist;
+   batch->innerCover = mInnerCover;
+
+   mCoverBatches.push_back(batchRef);
+   ThreadPool::GLOBAL().queueWorkItem(new NavCoverWorkItem(batch));
+   return true;
+}
+
+DefineEngineMethod(NavMesh, createCoverPoints, bool, (),,
+   "@brief Create cover points for this NavMesh.\n\n"
+   "Cover that has to be raycast is found in the background. NavMeshCoverProgress "
+   "events are posted as it is found, and NavMeshCoverUpdate when it is all done.")
+{
+   return object->createCoverPoints();
+}
+
+void NavMesh::cancelCover()
+{
+   // Workers hold their own references, so they can finish safely.
+   mCoverBatches.clear();
+   mCoverTiles.clear();
+   mCoverBatchCount = 0;
+}
+
+void NavMesh::cancelTileCover(U32 tile)
+{
+   for(U32 i = 0; i < mCoverTiles.size();)
+   {
+      if(mCoverTiles[i] == tile)
+      {
+         mCoverTiles.erase(i);
+         mCoverBatchCount--;
+      }
+      else
+         i++;
+   }
+   for(U32 i = 0; i < mCoverBatches.size();)
+   {
+      if(mCoverBatches[i]->tile == tile)
+      {
+         mCoverBatches.erase(i);
+         mCoverBatchCount--;
+      }
+      else
+         i++;
+   }
+}
+
+DefineEngineMethod(NavMesh, cancelCover, void, (),,
+   "@brief Stop generating cover points in the background.")
+{
+   object->cancelCover();
+}
+
+void NavMesh::updateCover()
+{
+   if(!mCoverBatchCount)
+      return;
+
+   U32 finished = 0;
+
+   // Collision can only be gathered here, so spread it over several ticks.
+   if(mCoverTiles.size())
+   {
+      dtNavMeshQuery *query = dtAllocNavMeshQuery();
+      if(query && dtStatusSucceed(query->init(nm, 1)))
+      {
+         for(U32 i = 0; i < CoverTilesPerTick && mCoverTiles.size(); i++)
+         {
+            const U32 t = mCoverTiles.front();
+            mCoverTiles.pop_front();
+            if(!startTileCover(t, query))
+               finished++;
+         }
+      }
+      dtFreeNavMeshQuery(query);
+   }
+
+   for(U32 i = 0; i < mCoverBatches.size();)
+   {
+      CoverBatch *batch = mCoverBatches[i];
+      if(!dAtomicRead(batch->done))
+      {
+         i++;
+         continue;
+      }
+      setTileCover(batch->tile, batch->results);
+      mCoverBatches.erase(i);
+      finished++;
+   }
+
+   if(finished && getEventManager())
+   {
+      String str = String::ToString("%d %d %d", getId(),
+         mCoverBatchCount - mCoverBatches.size() - mCoverTiles.size(), mCoverBatchCount);
+      getEventManager()->postEvent("NavMeshCoverProgress", str.c_str());
+   }
+
+   if(!mCoverBatches.size() && !mCoverTiles.size())
+   {
+      mCoverBatchCount = 0;
+      if(getEventManager())
+         getEventManager()->postEvent("NavMeshCoverUpdate", getIdString());
+   }
+}
+
+/// Is there solid geometry in a heightfield column at a given height?
+static bool isSolid(const rcHeightfield &hf, S32 x, S32 z, S32 h)
+{
+   if(x < 0 || z < 0 || x >= hf.width || z >= hf.height)
+      return false;
+   for(const rcSpan *s = hf.spans[x + z*hf.width]; s; s = s->next)
+   {
+      if((S32)s->smin <= h && h < (S32)s->smax)
+         return true;
+   }
+   return false;
+}
+
+/// Is there solid geometry anywhere along a line of heightfield columns?
+static bool isSolidAlong(const rcHeightfield &hf, S32 x, S32 z, S32 dx, S32 dz, S32 dist, S32 h)
+{
+   for(S32 k = 1; k <= dist; k++)
+   {
+      if(isSolid(hf, x + dx*k, z + dz*k, h))
+         return true;
+   }
+   return false;
+}
+
+bool NavMesh::testVoxelCover(const TileData &data, S32 x, S32 z, S32 y, S32 dir, CoverPointData &point)
+{
+   const rcHeightfield &hf = *data.hf;
+   const rcCompactHeightfield &chf = *data.chf;
+   const S32 dx = rcGetDirOffsetX(dir), dz = rcGetDirOffsetY(dir);
+   // Peeking happens perpendicular to the wall.
+   const S32 px = -dz, pz = dx;
+   const S32 coverCells = (S32)mCeil(mCoverDist / cfg.cs);
+   const S32 peekCells = (S32)mCeil(mPeekDist / cfg.cs);
+   const S32 overCells = (S32)mCeil(0.2f / cfg.ch);
+
+   point.peek[0] = point.peek[1] = point.peek[2] = false;
+   U32 hits = 0;
+   for(U32 j = 0; j < CoverPoint::NumSizes; j++)
+   {
+      // Test the middle of each size band, so we don't hit the floor.
+      const S32 h = y + cfg.walkableHeight * (2*j + 1) / (2*CoverPoint::NumSizes);
+      if(!isSolidAlong(hf, x, z, dx, dz, coverCells, h))
+         // No cover at this height - break off.
+         break;
+
+      point.peek[0] = !isSolidAlong(hf, x, z, px, pz, peekCells, h)
+         && !isSolidAlong(hf, x + px*peekCells, z + pz*peekCells, dx, dz, coverCells, h);
+      point.peek[1] = !isSolidAlong(hf, x, z, -px, -pz, peekCells, h)
+         && !isSolidAlong(hf, x - px*peekCells, z - pz*peekCells, dx, dz, coverCells, h);
+      point.peek[2] = !isSolid(hf, x, z, h + overCells)
+         && !isSolidAlong(hf, x, z, dx, dz, coverCells, h + overCells);
+
+      if(mInnerCover || point.peek[0] || point.peek[1] || point.peek[2])
+         hits++;
+   }
+   if(!hits)
+      return false;
+
+   point.size = (CoverPoint::Size)(hits - 1);
+   Point3F pos = RCtoDTS(
+      chf.bmin[0] + (x + 0.5f) * chf.cs,
+      chf.bmin[1] + y * chf.ch,
+      chf.bmin[2] + (z + 0.5f) * chf.cs);
+   point.trans = MathUtils::createOrientFromDir(RCtoDTS(Point3F(dx, 0.0f, dz)));
+   point.trans.setPosition(pos);
+   return true;
+}
+
+void NavMesh::generateCover(TileData &data)
+{
+   data.cover.clear();
+   data.hasCover = false;
+   if(mCoverMethod != Voxels || !data.hf || !data.chf)
+      return;
+   data.hasCover = true;
+
+   const rcCompactHeightfield &chf = *data.chf;
+   const S32 border = cfg.borderSize;
+
+   // Find every walkable span next to the edge of the walkable area, and look
+   // for walls beyond the edge.
+   Vector<CoverPointData> candidates;
+   for(S32 z = border; z < chf.height - border; z++)
+   {
+      for(S32 x = border; x < chf.width - border; x++)
+      {
+         const rcCompactCell &c = chf.cells[x + z*chf.width];
+         for(S32 i = c.index, ni = c.index + c.count; i < ni; i++)
+         {
+            if(chf.areas[i] == RC_NULL_AREA)
+               continue;
+            const rcCompactSpan &s = chf.spans[i];
+            for(S32 dir = 0; dir < 4; dir++)
+            {
+               if(rcGetCon(s, dir) != RC_NOT_CONNECTED)
+               {
+                  const S32 ax = x + rcGetDirOffsetX(dir);
+                  const S32 az = z + rcGetDirOffsetY(dir);
+                  const S32 ai = chf.cells[ax + az*chf.width].index + rcGetCon(s, dir);
+                  if(chf.areas[ai] != RC_NULL_AREA)
+                     continue;
+               }
+               CoverPointData point;
+               if(testVoxelCover(data, x, z, s.y, dir, point))
+                  candidates.push_back(point);
+            }
+         }
+      }
+   }
+
+   // Thin out the candidates, preferring points we can peek from. Points
+   // facing the same way must be at least a character's width apart.
+   const F32 spacing = mWalkableRadius * 2.0f;
+   for(U32 pass = 0; pass < 2; pass++)
+   {
+      for(U32 i = 0; i < candidates.size(); i++)
+      {
+         const CoverPointData &p = candidates[i];
+         const bool peeks = p.peek[0] || p.peek[1] || p.peek[2];
+         if(peeks != (pass == 0))
+            continue;
+         const Point3F pos = p.trans.getPosition();
+         const VectorF dir = p.trans.getForwardVector();
+         bool crowded = false;
+         for(U32 j = 0; j < data.cover.size(); j++)
+         {
+            const MatrixF &other = data.cover[j].trans;
+            if(mDot(dir, other.getForwardVector()) > 0.5f &&
+               (other.getPosition() - pos).lenSquared() < spacing * spacing)
+            {
+               crowded = true;
+               break;
+            }
+         }
+         if(!crowded)
+            data.cover.push_back(p);
+      }
+   }
+}
+
+void NavMesh::renderToDrawer()
+{
+   dd.clear();
+   // Recast debug draw
+   NetObject *no = getServerObject();
+   if(no)
+   {
+      NavMesh *n = static_cast<NavMesh*>(no);
+
+      if(n->nm)
+      {
+         dd.beginGroup(0);
+         duDebugDrawNavMesh       (&dd, *n->nm, 0);
+         dd.beginGroup(1);
+         duDebugDrawNavMeshPortals(&dd, *n->nm);
+         dd.beginGroup(2);
+         duDebugDrawNavMeshBVTree (&dd, *n->nm);
+      }
+   }
+}
+
+void NavMesh::prepRenderImage(SceneRenderState *state)
+{
+   ObjectRenderInst *ri = state->getRenderPass()->allocInst<ObjectRenderInst>();
+   ri->renderDelegate.bind(this, &NavMesh::render);
+   ri->type = RenderPassManager::RIT_Object;
+   ri->translucentSort = true;
+   ri->defaultKey = 1;
+   state->getRenderPass()->addInst(ri);
+}
+
+void NavMesh::render(ObjectRenderInst *ri, SceneRenderState *state, BaseMatInstance *overrideMat)
+{
+   if(overrideMat)
+      return;
 
    if(state->isReflectPass())
       return;
@@ -1438,10 +3816,14 @@ void NavMesh::onEditorEnable()
    mNetFlags.set(Ghostable);
    if(isClientObject() && !mAlwaysRender)
       addToScene();
+   if(isServerObject())
+      createCoverProxies();
 }
 
 void NavMesh::onEditorDisable()
 {
+   if(isServerObject())
+      deleteCoverProxies();
    if(!mAlwaysRender)
    {
       mNetFlags.clear(Ghostable);
@@ -1475,7 +3857,8 @@ void NavMesh::unpackUpdate(NetConnection *conn, BitStream *stream)
 }
 
 static const int NAVMESHSET_MAGIC = 'M'<<24 | 'S'<<16 | 'E'<<8 | 'T'; //'MSET';
-static const int NAVMESHSET_VERSION = 1;
+/// Version 2 adds per-tile cover after the links.
+static const int NAVMESHSET_VERSION = 2;
 
 struct NavMeshSetHeader
 {
@@ -1491,6 +3874,103 @@ struct NavMeshTileHeader
    int dataSize;
 };
 
+struct NavMeshCoverHeader
+{
+   int x, y;
+   int numPoints;
+};
+
+bool NavMesh::readCover(FILE *fp)
+{
+   S32 numTiles = 0;
+   if(fread(&numTiles, sizeof(S32), 1, fp) != 1)
+      return false;
+   for(S32 i = 0; i < numTiles; i++)
+   {
+      NavMeshCoverHeader coverHeader;
+      if(fread(&coverHeader, sizeof(coverHeader), 1, fp) != 1)
+         return false;
+      const U32 n = coverHeader.numPoints;
+      if(n > MaxTileCover)
+         return false;
+      // The file might not match our tiles if we were changed since it
+      // was saved, but we still have to step over its data.
+      S32 t = getTileIndex(coverHeader.x, coverHeader.y);
+      if(t >= (S32)MaxCoverTiles)
+         t = -1;
+      TileCover scratch;
+      TileCover &c = t >= 0 ? mCover[t] : scratch;
+      c.clear();
+      c.generation = ++mCoverGeneration;
+      c.px.setSize(n); c.py.setSize(n); c.pz.setSize(n);
+      c.nx.setSize(n); c.ny.setSize(n); c.nz.setSize(n);
+      c.size.setSize(n);
+      c.peek.setSize(n);
+      c.quality.setSize(n);
+      c.occupied.setSize(n);
+      c.generated = n;
+      if(n)
+      {
+         const bool ok =
+            fread(c.px.address(), sizeof(F32), n, fp) == n &&
+            fread(c.py.address(), sizeof(F32), n, fp) == n &&
+            fread(c.pz.address(), sizeof(F32), n, fp) == n &&
+            fread(c.nx.address(), sizeof(F32), n, fp) == n &&
+            fread(c.ny.address(), sizeof(F32), n, fp) == n &&
+            fread(c.nz.address(), sizeof(F32), n, fp) == n &&
+            fread(c.size.address(), sizeof(U8), n, fp) == n &&
+            fread(c.peek.address(), sizeof(U8), n, fp) == n;
+         if(!ok)
+         {
+            // Don't keep a partly-read tile around.
+            if(t >= 0)
+               clearTileCover(t);
+            return false;
+         }
+         c.quality.fill(1.0f);
+         c.occupied.fill(0);
+      }
+      c.valid = true;
+      if(t >= 0)
+         updateCoverProxies(t);
+   }
+   return true;
+}
+
+void NavMesh::writeCover(FILE *fp)
+{
+   S32 numTiles = 0;
+   for(U32 t = 0; t < mCover.size(); t++)
+   {
+      if(mCover[t].valid)
+         numTiles++;
+   }
+   fwrite(&numTiles, sizeof(S32), 1, fp);
+   for(U32 t = 0; t < mCover.size(); t++)
+   {
+      const TileCover &c = mCover[t];
+      if(!c.valid)
+         continue;
+      NavMeshCoverHeader coverHeader;
+      coverHeader.x = mTiles[t].x;
+      coverHeader.y = mTiles[t].y;
+      // Imported points are saved with the mission, not with us.
+      coverHeader.numPoints = c.generated;
+      fwrite(&coverHeader, sizeof(coverHeader), 1, fp);
+      const U32 n = c.generated;
+      if(!n)
+         continue;
+      fwrite(c.px.address(), sizeof(F32), n, fp);
+      fwrite(c.py.address(), sizeof(F32), n, fp);
+      fwrite(c.pz.address(), sizeof(F32), n, fp);
+      fwrite(c.nx.address(), sizeof(F32), n, fp);
+      fwrite(c.ny.address(), sizeof(F32), n, fp);
+      fwrite(c.nz.address(), sizeof(F32), n, fp);
+      fwrite(c.size.address(), sizeof(U8), n, fp);
+      fwrite(c.peek.address(), sizeof(U8), n, fp);
+   }
+}
+
 bool NavMesh::load()
 {
    if(!dStrlen(mFileName))
@@ -1508,12 +3988,20 @@ bool NavMesh::load()
       fclose(fp);
       return 0;
    }
-   if(header.version != NAVMESHSET_VERSION)
+   // Version 1 files are the same, just without cover.
+   if(header.version != NAVMESHSET_VERSION && header.version != 1)
    {
       fclose(fp);
       return 0;
    }
 
+   mSnapshots.clear();
+   mPathCache.clear();
+   mHierarchy.clear();
+   mLandmarks.clear();
+   mMeshVersion++;
+   failQueuedPaths();
+   freeQueries();
    if(nm)
       dtFreeNavMesh(nm);
    nm = dtAllocNavMesh();
@@ -1559,15 +4047,34 @@ bool NavMesh::load()
    mLinkSelectStates.fill(Unselected);
    mDeleteLinks.fill(false);
 
+   updateTiles();
+
+   const bool coverOk = header.version < 2 || readCover(fp);
+
    fclose(fp);
 
-   updateTiles();
+   // Mission cover points aren't in the file.
+   for(U32 t = 0; t < mCover.size(); t++)
+      importCoverPoints(t);
+
+   // Raycast cover again for any tiles the file didn't give us.
+   if(!coverOk && isServerObject())
+   {
+      Con::warnf("NavMesh %d: cover data in %s is damaged, regenerating it.", getId(), mFileName);
+      for(U32 t = 0; t < mCover.size(); t++)
+      {
+         if(!mCover[t].valid)
+            queueTileCover(t);
+      }
+   }
 
    if(isServerObject())
    {
       setMaskBits(LoadFlag);
       if(getEventManager())
          getEventManager()->postEvent("NavMeshUpdate", getIdString());
+      // Rebuilds the obstacles were waiting on went with the old tiles.
+      postObstacleEvents();
    }
 
    return true;
@@ -1631,6 +4138,8 @@ bool NavMesh::save()
    fwrite(mLinkFlags.address(), sizeof(unsigned short), s, fp);
    fwrite(mLinkIDs.address(), sizeof(U32), s, fp);
 
+   writeCover(fp);
+
    fclose(fp);
 
    return true;
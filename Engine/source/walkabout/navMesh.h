@@ -24,15 +24,22 @@
 #define _NAVMESH_H_
 
 #include <queue>
+#include <stdio.h>
 
 #include "scene/sceneObject.h"
 #include "collision/concretePolyList.h"
 #include "recastPolyList.h"
 #include "util/messaging/eventManager.h"
+#include "platform/threads/threadSafeRefCount.h"
+#include "platform/threads/mutex.h"
+#include "core/util/tSignal.h"
 
 #include "torqueRecast.h"
 #include "duDebugDrawTorque.h"
 #include "coverPoint.h"
+#include "navHierarchy.h"
+#include "navConnectivity.h"
+#include "navLandmarks.h"
 
 #include <Recast.h>
 #include <DetourNavMesh.h>
@@ -40,6 +47,28 @@
 #include <DebugDraw.h>
 #include <DetourNavMeshQuery.h>
 
+class NavPath;
+struct NavPathJob;
+struct NavPathBatch;
+struct NavLandmarkJob;
+
+/// A copy of a NavMesh's dtNavMesh that worker threads can read while the
+/// NavMesh updates its tiles. It is left alone while it has readers; once
+/// they are done, the NavMesh brings it up to date by copying in only the
+/// tiles that have changed since.
+struct NavMeshSnapshot : public ThreadSafeRefCount<NavMeshSnapshot>
+{
+   dtNavMesh *nm;
+   /// NavMesh versions whose tiles we hold.
+   U32 meshVersion, tileVersion;
+   /// Leases from NavMesh::acquireSnapshot not yet released. Only touched
+   /// on the main thread.
+   U32 readers;
+
+   NavMeshSnapshot() : nm(NULL), meshVersion(0), tileVersion(0), readers(0) {}
+   ~NavMeshSnapshot() { dtFreeNavMesh(nm); }
+};
+
 /// @class NavMesh
 /// Represents a set of bounds within which a Recast navigation mesh is generated.
 /// @see NavMeshPolyList
@@ -47,6 +76,8 @@
 class NavMesh : public SceneObject {
    typedef SceneObject Parent;
    friend class NavPath;
+   friend class NavCoverWorkItem;
+   friend class NavFlowField;
 
 public:
    /// @name NavMesh build
@@ -57,11 +88,159 @@ public:
    bool build(bool background = true, bool saveIntermediates = false);
    /// Stop a build in progress.
    void cancelBuild();
-   /// Generate cover points from a nav mesh.
+   /// Generate cover points for tiles that don't have them yet, or for all
+   /// tiles when raycasting. Raycast cover is tested in the background, and
+   /// NavMeshCoverUpdate is posted when done.
    bool createCoverPoints();
+   /// Stop generating cover points in the background.
+   void cancelCover();
    /// Remove all cover points
    void deleteCoverPoints();
 
+   /// @}
+
+   /// @name Queries
+   /// Pathfinding queries are pooled per NavMesh and leased out only while
+   /// a path is being planned.
+   /// @{
+
+   /// Lease a query attached to this mesh. Safe to call from any thread.
+   /// @param maxNodes Number of search nodes needed, or 0 for mQueryNodes.
+   /// @return NULL if a query could not be created.
+   dtNavMeshQuery *acquireQuery(U32 maxNodes = 0);
+
+   /// Return a leased query to the pool.
+   void releaseQuery(dtNavMeshQuery *query);
+
+   /// Lease a snapshot of the current navmesh for use off the main thread.
+   /// It won't change until every lease on it has been released.
+   /// @return NULL if there is no navmesh or it could not be copied.
+   ThreadSafeRef<NavMeshSnapshot> acquireSnapshot();
+
+   /// Return a leased snapshot. It stays alive while anyone still holds a
+   /// reference, but may be updated once it has no readers.
+   void releaseSnapshot(NavMeshSnapshot *snapshot);
+
+   /// @}
+
+   /// @name Batch planning
+   /// @{
+
+   /// A path planned by planPaths.
+   struct PathResult {
+      Vector<Point3F> points;
+      Vector<U16> flags;
+      F32 length;
+      bool success;
+      /// The search ran out of nodes, and points lead only as far as it
+      /// got towards the goal. success is false for these.
+      bool partial;
+   };
+
+   /// Plan many paths at once without creating NavPath objects. Endpoints
+   /// shared by several paths are only looked up once, and the paths are
+   /// planned on worker threads against a snapshot of the navmesh. The
+   /// results are delivered through mPathsPlannedSignal on a later tick.
+   /// @param from    Start of each path.
+   /// @param to      Goal of each path.
+   /// @param filter  Filter used for every path.
+   /// @param notifyScript Also call onPathsPlanned in script.
+   /// @return ID of the batch, passed to mPathsPlannedSignal.
+   U32 planPaths(const Vector<Point3F> &from, const Vector<Point3F> &to,
+                 const dtQueryFilter &filter, bool notifyScript = false);
+
+   /// Signal triggered with a planPaths batch's ID and one result per path.
+   typedef Signal<void(NavMesh*, U32, const Vector<PathResult>&)> PathsPlannedSignal;
+   PathsPlannedSignal mPathsPlannedSignal;
+
+   /// @}
+
+   /// @name Path cache
+   /// Polygon corridors found between pairs of polygons are kept, so that
+   /// repeated requests only need the straight path pass. An entry is
+   /// dropped when any tile it crosses is rebuilt. Main thread only.
+   /// @{
+
+   /// Look up the corridor between two polygons.
+   /// @return NULL if none is cached. Valid until the cache next changes.
+   const Vector<dtPolyRef> *findCorridor(dtPolyRef start, dtPolyRef end, const dtQueryFilter &filter);
+
+   /// Remember a complete corridor between two polygons.
+   void cacheCorridor(dtPolyRef start, dtPolyRef end, const dtQueryFilter &filter,
+                      const dtPolyRef *polys, U32 count);
+
+   /// Maximum number of cached corridors, or 0 to disable the cache.
+   S32 mPathCacheSize;
+
+   /// @}
+
+   /// @name Connectivity
+   /// @{
+
+   /// Could there be a path between two polygons under a filter? Answers
+   /// in constant time once our connectivity is known for the filter's
+   /// flags. That is worked out on the first request for those flags, at
+   /// the end of each build, and on the first request after any other
+   /// change to our tiles. Main thread only.
+   bool canReach(dtPolyRef from, dtPolyRef to, const dtQueryFilter &filter);
+
+   /// @}
+
+   /// @name Search heuristic
+   /// @{
+
+   /// Landmark heuristic for path searches on our current dtNavMesh. The
+   /// first request after our tiles change starts rebuilding it on a
+   /// worker thread, no more than once every LandmarkRefreshMS. Main
+   /// thread only.
+   /// @return NULL if landmarks are disabled, out of date, or we are still
+   ///         building.
+   const dtQueryHeuristic *getHeuristic();
+
+   /// Number of landmark polygons guiding path searches. 0 disables them.
+   S32 mLandmarkCount;
+
+   /// @}
+
+   /// @name Hierarchical planning
+   /// @{
+
+   /// Plan a route between two distant polygons over our tile portal
+   /// graph. The caller searches between each pair of polygons along it
+   /// to get a corridor. Main thread only.
+   /// @see NavMeshHierarchy::findRoute
+   /// @return False if the polygons are too close to bother, the graph is
+   ///         still being built, or no route was found.
+   bool findHierarchicalRoute(dtPolyRef startRef, dtPolyRef endRef,
+                              const F32 *from, const F32 *to,
+                              const dtQueryFilter &filter,
+                              Vector<dtPolyRef> &refs, Vector<Point3F> &points);
+
+   /// Polygons at least this many tiles apart are planned between
+   /// hierarchically. 0 disables hierarchical planning.
+   S32 mHierarchyTiles;
+
+   /// Default number of search nodes in each query.
+   S32 mQueryNodes;
+
+   /// Add a sliced NavPath to be updated within our per-tick budget.
+   void queuePath(NavPath *path);
+
+   /// Stop updating a sliced NavPath.
+   void dequeuePath(NavPath *path);
+
+   /// Total sliced path search iterations we run each tick.
+   S32 mPathBudget;
+
+   /// Plan a threaded NavPath on a worker. The job is started at the end of
+   /// this tick, and its result handed back to the path on a later one.
+   void queuePathJob(NavPathJob *job);
+
+   /// @}
+
+   /// @name NavMesh build
+   /// @{
+
    /// Save the navmesh to a file.
    bool save();
    /// Load a saved navmesh from a file.
@@ -76,6 +255,12 @@ public:
    /// Rebuild parts of the navmesh where links have changed.
    void buildLinks();
 
+   /// Queue a change to the obstacles in a given area. Overlapped tiles are
+   /// re-carved on the next tick.
+   /// @param box   World box the obstacle covers (or used to cover).
+   /// @param added Was an obstacle added (true) or removed (false)?
+   void updateObstacle(const Box3F &box, bool added);
+
    /// Data file to store this nav mesh in. (From engine executable dir.)
    StringTableEntry mFileName;
 
@@ -167,11 +352,12 @@ public:
    /// @name Annotations
    /// @{
 
-   /// Should we automatically generate jump-down links?
+   /// Should we automatically generate jump and drop links?
    bool mJumpDownLinks;
-   /// Height of a 'small' jump link.
+   /// Height of a 'small' jump link. Characters may jump up this far, or
+   /// across a gap this wide.
    F32 mJumpLinkSmall;
-   /// Height of a 'large' jump link.
+   /// Height of a 'large' jump link. Characters may drop down this far.
    F32 mJumpLinkLarge;
 
    /// Distance to search for cover.
@@ -183,6 +369,64 @@ public:
    /// Add cover to walls that don't have corners?
    bool mInnerCover;
 
+   /// How cover points are found.
+   enum CoverMethod {
+      Voxels,
+      Raycast
+   };
+
+   CoverMethod mCoverMethod;
+
+   /// @}
+
+   /// @name Cover queries
+   /// Cover is stored per tile rather than as CoverPoint objects. A CoverRef
+   /// identifies a single point, and goes stale when its tile is rebuilt.
+   /// Script sees references as strings, with "-1" for no cover.
+   /// @{
+
+   typedef U64 CoverRef;
+   static const CoverRef NullCover;
+
+   /// Format a cover reference for script.
+   static const char *getCoverRefString(CoverRef ref);
+   /// Parse a cover reference from script. Returns NullCover on failure.
+   static CoverRef getCoverRefFromString(const char *str);
+
+   /// Find the best unoccupied cover near a position.
+   /// @param loc     Position of the character looking for cover.
+   /// @param from    Position to take cover from.
+   /// @param radius  Distance from loc to search.
+   /// @param reserve Atomically mark the cover as occupied, so that no other
+   ///                search can return it.
+   CoverRef findCover(const Point3F &loc, const Point3F &from, F32 radius, bool reserve = false);
+
+   /// Does this reference a cover point that still exists?
+   bool isCoverValid(CoverRef ref) const;
+
+   /// Number of cover points in this mesh.
+   U32 getCoverCount() const;
+
+   /// Get the position of a cover point.
+   Point3F getCoverPosition(CoverRef ref) const;
+   /// Get the direction a cover point faces (towards the wall).
+   VectorF getCoverNormal(CoverRef ref) const;
+   /// Get the size of a cover point.
+   CoverPoint::Size getCoverSize(CoverRef ref) const;
+   /// Can we peek left, right or over a cover point?
+   void getCoverPeek(CoverRef ref, bool &left, bool &right, bool &over) const;
+
+   /// Is someone already using this cover point?
+   bool isCoverOccupied(CoverRef ref) const;
+   /// Set whether someone is using this cover point.
+   bool setCoverOccupied(CoverRef ref, bool occupied);
+   /// Mark a cover point as occupied, failing if it already was.
+   bool reserveCover(CoverRef ref);
+
+   /// Re-import mission CoverPoint objects in the tiles overlapping a box.
+   /// Called by CoverPoints when they are added, moved or removed.
+   void updateCoverPoints(const Box3F &box);
+
    /// @}
 
    /// @name SimObject
@@ -252,6 +496,11 @@ protected:
 
    dtNavMesh const* getNavMesh() { return nm; }
 
+   /// Incremented whenever our dtNavMesh is replaced.
+   U32 getMeshVersion() const { return mMeshVersion; }
+   /// Incremented whenever a tile is replaced.
+   U32 getTileVersion() const { return mTileVersion; }
+
 private:
    /// Generates a navigation mesh for the collection of objects in this
    /// mesh. Returns true if successful. Stores the created mesh in tnm.
@@ -287,14 +536,34 @@ private:
       }
    };
 
+   struct CoverPointData {
+      MatrixF trans;
+      CoverPoint::Size size;
+      bool peek[3];
+   };
+
    /// Intermediate data for tile creation.
    struct TileData {
       RecastPolyList          geom;
       rcHeightfield        *hf;
+      /// Kept for every built tile so obstacles can be carved into it
+      /// without voxelising the tile again. Costs about 12 bytes per span
+      /// plus 4 per cell, i.e. roughly 100-200KB for a 64x64 tile with a
+      /// few floors. Tiles loaded from a file have none until rebuilt.
       rcCompactHeightfield *chf;
       rcContourSet         *cs;
       rcPolyMesh           *pm;
       rcPolyMeshDetail     *pmd;
+      /// Span areas of chf before any obstacles were carved into it.
+      Vector<U8> areas;
+      /// Start and end points of automatically-generated links.
+      Vector<F32> linkVerts;
+      /// Flags of automatically-generated links.
+      Vector<U16> linkFlags;
+      /// Cover points found in this tile's heightfields.
+      Vector<CoverPointData> cover;
+      /// Was cover generated when this tile was built?
+      bool hasCover;
       TileData()
       {
          hf = NULL;
@@ -302,15 +571,39 @@ private:
          cs = NULL;
          pm = NULL;
          pmd = NULL;
+         hasCover = false;
       }
-      void freeAll()
+      /// Free the data generated from the compact heightfield.
+      void freeMesh()
       {
-         geom.clear();
-         rcFreeHeightField(hf);
-         rcFreeCompactHeightfield(chf);
          rcFreeContourSet(cs);
          rcFreePolyMesh(pm);
          rcFreePolyMeshDetail(pmd);
+         cs = NULL;
+         pm = NULL;
+         pmd = NULL;
+      }
+      /// Free everything except, optionally, what we need to re-carve.
+      void freeIntermediates(bool keepHeightfield)
+      {
+         geom.clear();
+         rcFreeHeightField(hf);
+         hf = NULL;
+         freeMesh();
+         if(!keepHeightfield)
+         {
+            rcFreeCompactHeightfield(chf);
+            chf = NULL;
+            areas.clear();
+            linkVerts.clear();
+            linkFlags.clear();
+         }
+      }
+      void freeAll()
+      {
+         freeIntermediates(false);
+         cover.clear();
+         hasCover = false;
       }
       ~TileData()
       {
@@ -333,6 +626,77 @@ private:
    /// Generates navmesh data for a single tile.
    unsigned char *buildTileData(const Tile &tile, TileData &data, U32 &dataSize);
 
+   /// Generates navmesh data for a tile from its compact heightfield.
+   unsigned char *buildTileMesh(const Tile &tile, TileData &data, U32 &dataSize);
+
+   /// Generate jump and drop links from the boundary edges of a tile's
+   /// rcPolyMesh, using its heightfields to find landing spots.
+   void generateLinks(TileData &data);
+
+   /// Step away from a boundary edge through the heightfields, looking for a
+   /// place to land. Coordinates are in cells relative to the heightfields.
+   /// @param data  Tile data with both heightfields.
+   /// @param x, z  Cell coordinates of the point on the edge.
+   /// @param y     Floor height of the edge.
+   /// @param nx, nz Outward edge normal.
+   /// @param end   Filled with the Recast-space landing point.
+   /// @param flags Filled with the type of link found.
+   bool probeLink(const TileData &data, F32 x, F32 z, S32 y, F32 nx, F32 nz, F32 *end, U16 &flags);
+
+   /// Find cover along the edges of a tile's walkable area.
+   void generateCover(TileData &data);
+
+   /// Test for cover next to a heightfield cell in one direction.
+   /// @param data  Tile data with both heightfields.
+   /// @param x, z  Cell to test from.
+   /// @param y     Floor height of the cell.
+   /// @param dir   Recast direction (0-3) to look for a wall in.
+   /// @param point Filled with the cover point, if there is one.
+   bool testVoxelCover(const TileData &data, S32 x, S32 z, S32 y, S32 dir, CoverPointData &point);
+
+   /// Swap a tile's data in the dtNavMesh for new data. If the new data is
+   /// NULL, the tile is just removed.
+   bool replaceTile(const Tile &tile, unsigned char *data, U32 dataSize);
+
+   /// @}
+
+   /// @name Obstacles
+   /// @{
+
+   struct ObstacleUpdate {
+      /// World box of the change.
+      Box3F box;
+      /// Was an obstacle added or removed?
+      bool added;
+   };
+
+   /// Obstacle changes waiting to be applied next tick.
+   Vector<ObstacleUpdate> mObstacleUpdates;
+
+   /// Obstacle changes whose tiles are queued for a full rebuild. Their
+   /// events are posted once the dirty tiles have been built.
+   Vector<ObstacleUpdate> mObstacleEvents;
+
+   /// Apply all pending obstacle changes.
+   void processObstacles();
+
+   /// Post NavMeshObstacleAdded/Removed for the changes in mObstacleEvents.
+   void postObstacleEvents();
+
+   /// Rebuild a tile's mesh from its cached heightfield with the current
+   /// set of obstacles carved out of it.
+   /// @return False if the tile had no heightfield and was queued for a
+   ///         full rebuild instead.
+   bool carveTile(U32 i);
+
+   /// Carve every obstacle overlapping a tile into its heightfield.
+   void markObstacles(const Tile &tile, rcCompactHeightfield &chf);
+
+   /// Region around a tile in which an obstacle affects its heightfield.
+   /// Covers the tile's build border plus the actor radius obstacles are
+   /// expanded by when carved.
+   Box3F getObstacleBox(const Tile &tile) const;
+
    /// @}
 
    /// @name Off-mesh links
@@ -376,17 +740,254 @@ private:
 
    /// @}
 
+   /// @name Queries
+   /// @{
+
+   /// Idle queries, kept sorted by node count.
+   struct PooledQuery {
+      dtNavMeshQuery *query;
+      U32 nodes;
+   };
+   Vector<PooledQuery> mQueryPool;
+
+   /// Guards mQueryPool.
+   Mutex mQueryMutex;
+
+   /// Free all idle queries.
+   void freeQueries();
+
+   /// Sliced paths waiting to be updated.
+   Vector<SimObjectPtr<NavPath> > mPathQueue;
+
+   /// Where in mPathQueue the next tick's updates start.
+   U32 mPathQueueHead;
+
+   /// Spend this tick's budget on queued paths.
+   void updatePaths();
+
+   /// Stop every queued path before our dtNavMesh is freed, since their
+   /// queries are attached to it. They fail, and are told so next tick.
+   void failQueuedPaths();
+
+   /// Paths stopped by failQueuedPaths that haven't been told yet.
+   Vector<SimObjectPtr<NavPath> > mFailedPaths;
+
+   U32 mMeshVersion;
+   U32 mTileVersion;
+
+   /// Snapshots of our tiles for this mesh version, newest last. Idle ones
+   /// are kept to be updated and reused.
+   Vector<ThreadSafeRef<NavMeshSnapshot> > mSnapshots;
+
+   /// mTileVersion when each tile was last replaced.
+   Vector<U32> mTileVersions;
+
+   /// Make a snapshot with a copy of every tile.
+   ThreadSafeRef<NavMeshSnapshot> createSnapshot();
+
+   /// Replace the tiles in an idle snapshot that have changed since it was
+   /// taken. Returns false if it couldn't be updated.
+   bool syncSnapshot(NavMeshSnapshot *snapshot);
+
+   struct CachedCorridor {
+      dtPolyRef start, end;
+      U16 includeFlags, excludeFlags;
+      Vector<dtPolyRef> polys;
+      /// Tiles the corridor crosses, as (x << 16) | y.
+      Vector<U32> tiles;
+      /// mPathCacheClock when last used.
+      U32 lastUsed;
+   };
+   Vector<CachedCorridor> mPathCache;
+   U32 mPathCacheClock;
+
+   /// Drop cached corridors that cross a tile.
+   void invalidateCorridors(S32 x, S32 y);
+
+   /// Entrances on tile borders and the costs between them.
+   NavMeshHierarchy mHierarchy;
+   /// Tiles of the hierarchy rebuilt each tick.
+   static const U32 HierarchyTilesPerTick = 4;
+
+   /// Bring a few more tiles of the hierarchy up to date.
+   void updateHierarchy();
+
+   /// Connectivity for each set of filter flags we've been asked about.
+   Vector<NavMeshConnectivity> mConnectivity;
+   static const U32 MaxConnectivityClasses = 8;
+
+   /// Costs to and from landmark polygons, for the search heuristic.
+   NavMeshLandmarks mLandmarks;
+   /// Real time the landmarks were last rebuilt.
+   U32 mLandmarkTime;
+   static const U32 LandmarkRefreshMS = 1000;
+
+   /// Landmarks being rebuilt on a worker thread.
+   ThreadSafeRef<NavLandmarkJob> mLandmarkJob;
+
+   /// Take the landmarks from a finished job.
+   void updateLandmarks();
+
+   /// Relabel all known connectivity classes that are out of date.
+   void updateConnectivity();
+
+   /// Threaded path jobs, started or waiting to start.
+   Vector<ThreadSafeRef<NavPathJob> > mPathJobs;
+
+   /// Are any started path jobs still reading the navmesh?
+   bool pathJobsRunning() const;
+
+   /// Hand finished path jobs back to their paths.
+   void updatePathJobs();
+
+   /// Give a job's results to its path, then tell the path's listeners.
+   void completePathJob(NavPathJob *job);
+
+   /// Send waiting path jobs to the thread pool.
+   void startPathJobs();
+
+   /// Wait for running path jobs, then fail any that haven't started.
+   void cancelPathJobs();
+
+   /// planPaths batches waiting on worker threads.
+   Vector<ThreadSafeRef<NavPathBatch> > mPathBatches;
+
+   /// ID of the last batch from planPaths.
+   U32 mPathBatchId;
+
+   /// Are workers still planning any batches?
+   bool pathBatchesRunning() const;
+
+   /// Deliver the results of finished batches.
+   void updatePathBatches();
+
+   /// Tidy up after a finished batch, then tell its listeners.
+   void completePathBatch(NavPathBatch *batch);
+
+   /// Wait for running batches and deliver them.
+   void cancelPathBatches();
+
+   /// @}
+
    /// @name Cover
    /// @{
 
-   struct CoverPointData {
-      MatrixF trans;
-      CoverPoint::Size size;
-      bool peek[3];
+   /// Cover candidates for one tile, tested on a worker thread.
+   struct CoverBatch;
+
+   /// Batches of cover still being tested.
+   Vector<ThreadSafeRef<CoverBatch> > mCoverBatches;
+
+   /// Tiles waiting for their batches to be gathered in updateCover.
+   Vector<U32> mCoverTiles;
+
+   /// Number of tiles queued since cover generation last finished.
+   U32 mCoverBatchCount;
+
+   /// Start batches for a few queued tiles, and collect the results of any
+   /// completed ones.
+   void updateCover();
+
+   /// Peek directions, packed into TileCover::peek.
+   enum CoverPeek {
+      PeekLeft  = BIT(0),
+      PeekRight = BIT(1),
+      PeekOver  = BIT(2)
    };
 
-   /// Attempt to place cover points along a given edge.
-   bool testEdgeCover(const Point3F &pos, const VectorF &dir, CoverPointData &data);
+   /// Cover points in a single tile, stored as parallel arrays so scoring
+   /// can run over them in tight loops.
+   struct TileCover {
+      Vector<F32> px, py, pz;
+      Vector<F32> nx, ny, nz;
+      Vector<U8> size;
+      Vector<U8> peek;
+      /// Multiplies a point's score. 1 for generated cover.
+      Vector<F32> quality;
+      /// Only modified with atomic operations.
+      Vector<U32> occupied;
+      /// Set from mCoverGeneration whenever this tile's cover is replaced,
+      /// so old references can be detected.
+      U32 generation;
+      /// Has cover been generated for this tile?
+      bool valid;
+      /// Number of points we generated. Points after these are imported
+      /// from CoverPoint objects placed in the mission.
+      U32 generated;
+      /// CoverPoint objects displaying this tile's cover in the editor.
+      Vector<SimObjectPtr<CoverPoint> > proxies;
+      TileCover() : generation(0), valid(false), generated(0) {}
+      U32 count() const { return px.size(); }
+      /// Replace all cover points in this tile.
+      void set(const Vector<CoverPointData> &points);
+      /// Remove all cover points from this tile.
+      void clear();
+      /// Drop all points after the first n.
+      void truncate(U32 n);
+   };
+
+   /// Cover for each tile.
+   Vector<TileCover> mCover;
+
+   /// Last generation given to a tile's cover. Kept across rebuilds of the
+   /// tile grid so references from an old grid never match a new one.
+   U32 mCoverGeneration;
+
+   /// Replace the cover for a tile.
+   void setTileCover(U32 tile, const Vector<CoverPointData> &points);
+   /// Remove a tile's cover, marking it as needing to be generated.
+   void clearTileCover(U32 tile);
+   /// Replace a tile's imported cover with the CoverPoint objects now in it.
+   void importCoverPoints(U32 tile);
+
+   /// Queue a single tile to be raycast for cover. Gathering its candidates
+   /// and collision has to happen on the main thread, so updateCover only
+   /// does a few tiles each tick.
+   /// @return True if the tile was queued.
+   bool queueTileCover(U32 tile);
+
+   /// Gather a tile's cover candidates and collision, and start raycasting
+   /// them on a worker thread.
+   /// @param tile  Index of the tile to test.
+   /// @param query Query to find wall segments with.
+   /// @return True if a batch was started. Otherwise the tile's cover has
+   ///         already been set.
+   bool startTileCover(U32 tile, dtNavMeshQuery *query);
+
+   /// Drop any cover batches queued or still running for a tile.
+   void cancelTileCover(U32 tile);
+
+   /// Read per-tile cover saved after the tiles in a navmesh file.
+   /// @return False if the cover data was truncated or corrupt. Tiles read
+   ///         before the damage keep their cover; the rest have none.
+   bool readCover(FILE *fp);
+   /// Write per-tile cover to a navmesh file.
+   void writeCover(FILE *fp);
+
+   /// Unpack a CoverRef, returning false if it is stale.
+   bool getCoverIndex(CoverRef ref, U32 &tile, U32 &idx) const;
+
+   /// Group holding the CoverPoint objects we display in the editor. NULL
+   /// while we aren't displaying cover.
+   SimObjectPtr<SimSet> mCoverProxies;
+
+   /// Create CoverPoint objects to display our cover in the editor.
+   void createCoverProxies();
+   /// Remove editor CoverPoint objects.
+   void deleteCoverProxies();
+   /// Recreate the editor CoverPoint objects for a single tile, if we are
+   /// displaying cover.
+   void updateCoverProxies(U32 tile);
+
+   /// Find the index of the tile at the given tile coordinates.
+   S32 getTileIndex(U32 x, U32 y) const;
+
+   /// Number of tiles along each axis of the tile grid.
+   U32 mTilesX, mTilesY;
+
+   /// Get the range of tile coordinates overlapping a world box.
+   /// @return False if the box misses the tile grid.
+   bool getTileRange(const Box3F &box, U32 &x0, U32 &y0, U32 &x1, U32 &y1) const;
 
    /// @}
 
@@ -420,7 +1021,75 @@ private:
    static SimObjectPtr<EventManager> smEventManager;
 };
 
+/// Shared state of a planPaths call.
+struct NavPathBatch : public ThreadSafeRefCount<NavPathBatch>
+{
+   /// @name Main thread only
+   /// @{
+
+   U32 id;
+   bool notifyScript;
+   /// Keeps the mesh alive while workers read it.
+   ThreadSafeRef<NavMeshSnapshot> snapshot;
+   /// Leased for each set of paths given to a worker.
+   Vector<dtNavMeshQuery*> queries;
+   /// Number of work items started.
+   U32 queued;
+
+   /// @}
+
+   /// @name Input
+   /// @{
+
+   dtQueryFilter filter;
+   Vector<Point3F> from;
+   Vector<Point3F> to;
+   /// Nearest polygon to each distinct endpoint.
+   Vector<dtPolyRef> refs;
+   /// Index into refs of each path's start and goal.
+   Vector<U32> startIdx;
+   Vector<U32> endIdx;
+   /// Copy of our NavMesh's cached corridor for each path, if it had one.
+   Vector<Vector<dtPolyRef> > cached;
+
+   /// @}
+
+   /// @name Output
+   /// Each worker only writes the paths it was given.
+   /// @{
+
+   /// Complete corridors found for paths that weren't cached.
+   Vector<Vector<dtPolyRef> > found;
+   Vector<NavMesh::PathResult> results;
+
+   /// @}
+
+   /// Incremented by each work item when it's done.
+   volatile U32 done;
+
+   NavPathBatch() : id(0), notifyScript(false), queued(0), done(0) {}
+
+   /// Plan paths [start, end) with the given query.
+   void run(dtNavMeshQuery *query, U32 start, U32 end);
+};
+
+/// Landmarks being rebuilt from a snapshot of a NavMesh's tiles.
+struct NavLandmarkJob : public ThreadSafeRefCount<NavLandmarkJob>
+{
+   /// Keeps the mesh alive while the worker reads it.
+   ThreadSafeRef<NavMeshSnapshot> snapshot;
+   U32 count;
+   /// Only touched by the worker until done is set.
+   NavMeshLandmarks landmarks;
+   volatile U32 done;
+
+   NavLandmarkJob() : count(0), done(0) {}
+};
+
 typedef NavMesh::WaterMethod NavMeshWaterMethod;
 DefineEnumType(NavMeshWaterMethod);
 
+typedef NavMesh::CoverMethod NavMeshCoverMethod;
+DefineEnumType(NavMeshCoverMethod);
+
 #endif
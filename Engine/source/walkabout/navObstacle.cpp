@@ -0,0 +1,350 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2014 Daniel Buckmaster
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "navObstacle.h"
+#include "navMesh.h"
+#include "torqueRecast.h"
+
+#include "math/mathIO.h"
+#include "scene/sceneRenderState.h"
+#include "core/stream/bitStream.h"
+#include "gfx/gfxDrawUtil.h"
+#include "renderInstance/renderPassManager.h"
+#include "console/consoleTypes.h"
+#include "console/engineAPI.h"
+
+extern bool gEditingMission;
+
+IMPLEMENT_CO_NETOBJECT_V1(NavObstacle);
+
+ConsoleDocClass(NavObstacle,
+   "@brief A box or cylinder that blocks navigation through any NavMesh it overlaps.\n\n"
+   "Obstacles carve the already-voxelised NavMesh tiles they touch, so they can "
+   "be moved or deleted at runtime much more cheaply than rebuilding tiles.\n\n"
+   "The obstacle stands on its origin and is sized by its scale.\n\n"
+);
+
+ImplementEnumType(NavObstacleShape,
+   "The shape of a NavObstacle.\n")
+   { NavObstacle::Box,      "Box",      "Carve out the obstacle's oriented box.\n" },
+   { NavObstacle::Cylinder, "Cylinder", "Carve out an upright cylinder fitting inside the obstacle's box.\n" },
+EndImplementEnumType;
+
+SimObjectPtr<SimSet> NavObstacle::smServerSet = NULL;
+
+SimSet *NavObstacle::getServerSet()
+{
+   if(!smServerSet)
+   {
+      SimSet *set = NULL;
+      if(Sim::findObject("ServerNavObstacleSet", set))
+         smServerSet = set;
+      else
+      {
+         smServerSet = new SimSet();
+         smServerSet->registerObject("ServerNavObstacleSet");
+         Sim::getRootGroup()->addObject(smServerSet);
+      }
+   }
+   return smServerSet;
+}
+
+//-----------------------------------------------------------------------------
+// Object setup and teardown
+//-----------------------------------------------------------------------------
+NavObstacle::NavObstacle()
+{
+   mNetFlags.clear(Ghostable);
+   mTypeMask |= MarkerObjectType;
+   mShape = Cylinder;
+}
+
+NavObstacle::~NavObstacle()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Object Editing
+//-----------------------------------------------------------------------------
+void NavObstacle::initPersistFields()
+{
+   addGroup("NavObstacle");
+
+   addField("shape", TYPEID<NavObstacleShape>(), Offset(mShape, NavObstacle),
+      "The shape of the area this obstacle carves out of NavMeshes.");
+
+   endGroup("NavObstacle");
+
+   Parent::initPersistFields();
+}
+
+bool NavObstacle::onAdd()
+{
+   if(!Parent::onAdd())
+      return false;
+
+   // Unit box standing on our origin; scale gives the actual size.
+   mObjBox.set(Point3F(-0.5f, -0.5f, 0.0f),
+               Point3F( 0.5f,  0.5f, 1.0f));
+   resetWorldBox();
+
+   if(gEditingMission)
+      onEditorEnable();
+
+   addToScene();
+
+   if(isServerObject())
+   {
+      getServerSet()->addObject(this);
+      notifyMeshes(getWorldBox(), true);
+   }
+
+   return true;
+}
+
+void NavObstacle::onRemove()
+{
+   if(isServerObject())
+   {
+      getServerSet()->removeObject(this);
+      notifyMeshes(getWorldBox(), false);
+   }
+
+   if(gEditingMission)
+      onEditorDisable();
+
+   removeFromScene();
+
+   Parent::onRemove();
+}
+
+void NavObstacle::setTransform(const MatrixF &mat)
+{
+   Box3F old = getWorldBox();
+   Parent::setTransform(mat);
+   setMaskBits(TransformMask);
+   if(isServerObject() && isProperlyAdded())
+   {
+      notifyMeshes(old, false);
+      notifyMeshes(getWorldBox(), true);
+   }
+}
+
+void NavObstacle::setScale(const VectorF &scale)
+{
+   Box3F old = getWorldBox();
+   Parent::setScale(scale);
+   setMaskBits(TransformMask);
+   if(isServerObject() && isProperlyAdded())
+   {
+      notifyMeshes(old, false);
+      notifyMeshes(getWorldBox(), true);
+   }
+}
+
+void NavObstacle::onEditorEnable()
+{
+   mNetFlags.set(Ghostable);
+}
+
+void NavObstacle::onEditorDisable()
+{
+   mNetFlags.clear(Ghostable);
+}
+
+void NavObstacle::inspectPostApply()
+{
+   setMaskBits(TransformMask);
+   // Our shape may have changed.
+   if(isServerObject())
+      notifyMeshes(getWorldBox(), true);
+}
+
+void NavObstacle::notifyMeshes(const Box3F &box, bool added)
+{
+   SimSet *set = NavMesh::getServerSet();
+   for(U32 i = 0; i < set->size(); i++)
+   {
+      NavMesh *m = static_cast<NavMesh*>(set->at(i));
+      if(m->getWorldBox().isOverlapped(box))
+         m->updateObstacle(box, added);
+   }
+}
+
+//-----------------------------------------------------------------------------
+// Carving
+//-----------------------------------------------------------------------------
+
+void NavObstacle::carve(rcContext *ctx, F32 radius, F32 height, rcCompactHeightfield &chf) const
+{
+   const Box3F &box = getWorldBox();
+   // Spans are marked by their floor height, so extend downwards to catch
+   // floors a character would be standing on when they hit us.
+   const F32 hmin = box.minExtents.z - height;
+   const F32 hmax = box.maxExtents.z;
+
+   if(mShape == Cylinder)
+   {
+      const VectorF &scale = getScale();
+      Point3F base = DTStoRC(Point3F(getPosition().x, getPosition().y, hmin));
+      F32 r = getMax(scale.x, scale.y) * 0.5f + radius;
+      rcMarkCylinderArea(ctx, base, r, hmax - hmin, RC_NULL_AREA, chf);
+   }
+   else
+   {
+      // Take our footprint in world space, then expand it by the radius
+      // there, so zero or uneven scales don't distort the expansion.
+      const Box3F &obj = mObjBox;
+      const Point3F corners[4] = {
+         Point3F(obj.minExtents.x, obj.minExtents.y, 0.0f),
+         Point3F(obj.maxExtents.x, obj.minExtents.y, 0.0f),
+         Point3F(obj.maxExtents.x, obj.maxExtents.y, 0.0f),
+         Point3F(obj.minExtents.x, obj.maxExtents.y, 0.0f),
+      };
+      MatrixF mat = getTransform();
+      mat.scale(getScale());
+      F32 verts[4*3];
+      Point3F centre(0.0f, 0.0f, 0.0f);
+      for(U32 i = 0; i < 4; i++)
+      {
+         Point3F p;
+         mat.mulP(corners[i], &p);
+         p = DTStoRC(p);
+         verts[i*3+0] = p.x;
+         verts[i*3+1] = p.y;
+         verts[i*3+2] = p.z;
+         centre += p * 0.25f;
+      }
+      // rcOffsetPoly only grows polygons wound counter-clockwise.
+      F32 area = 0.0f;
+      for(U32 i = 0; i < 4; i++)
+      {
+         const F32 *a = &verts[i*3];
+         const F32 *b = &verts[((i+1)%4)*3];
+         area += a[0]*b[2] - b[0]*a[2];
+      }
+      if(area < 0.0f)
+      {
+         for(U32 k = 0; k < 3; k++)
+         {
+            const F32 t = verts[1*3+k];
+            verts[1*3+k] = verts[3*3+k];
+            verts[3*3+k] = t;
+         }
+      }
+      F32 expanded[12*3];
+      const S32 count = mFabs(area) > 1e-6f
+         ? rcOffsetPoly(verts, 4, radius, expanded, 12)
+         : 0;
+      if(count)
+         rcMarkConvexPolyArea(ctx, expanded, count, hmin, hmax, RC_NULL_AREA, chf);
+      else
+      {
+         // Flattened to a line or a point; cover it with a cylinder.
+         F32 r = 0.0f;
+         for(U32 i = 0; i < 4; i++)
+         {
+            const Point3F p(verts[i*3+0], verts[i*3+1], verts[i*3+2]);
+            r = getMax(r, mSqrt(mSquared(p.x - centre.x) + mSquared(p.z - centre.z)));
+         }
+         const F32 base[3] = { centre.x, hmin, centre.z };
+         rcMarkCylinderArea(ctx, base, r + radius, hmax - hmin, RC_NULL_AREA, chf);
+      }
+   }
+}
+
+//-----------------------------------------------------------------------------
+// Networking
+//-----------------------------------------------------------------------------
+
+U32 NavObstacle::packUpdate(NetConnection *conn, U32 mask, BitStream *stream)
+{
+   U32 retMask = Parent::packUpdate(conn, mask, stream);
+
+   stream->writeInt(mShape, 2);
+
+   if(stream->writeFlag(mask & TransformMask))
+   {
+      mathWrite(*stream, getTransform());
+      mathWrite(*stream, getScale());
+   }
+
+   return retMask;
+}
+
+void NavObstacle::unpackUpdate(NetConnection *conn, BitStream *stream)
+{
+   Parent::unpackUpdate(conn, stream);
+
+   mShape = (Shape)stream->readInt(2);
+
+   if(stream->readFlag()) // TransformMask
+   {
+      mathRead(*stream, &mObjToWorld);
+      mathRead(*stream, &mObjScale);
+
+      setTransform(mObjToWorld);
+   }
+}
+
+//-----------------------------------------------------------------------------
+// Object Rendering
+//-----------------------------------------------------------------------------
+
+void NavObstacle::prepRenderImage(SceneRenderState *state)
+{
+   ObjectRenderInst *ri = state->getRenderPass()->allocInst<ObjectRenderInst>();
+   ri->renderDelegate.bind(this, &NavObstacle::render);
+   ri->type = RenderPassManager::RIT_Editor;
+   ri->defaultKey = 0;
+   ri->defaultKey2 = 0;
+   state->getRenderPass()->addInst(ri);
+}
+
+void NavObstacle::render(ObjectRenderInst *ri, SceneRenderState *state, BaseMatInstance *overrideMat)
+{
+   if(overrideMat)
+      return;
+
+   PROFILE_SCOPE(NavObstacle_Render);
+
+   GFXDrawUtil *drawer = GFX->getDrawUtil();
+
+   GFXStateBlockDesc desc;
+   desc.setZReadWrite(true, false);
+   desc.setBlend(true);
+   desc.setCullMode(GFXCullNone);
+
+   const ColorI colour(255, 60, 0, 80);
+   const VectorF &scale = getScale();
+   if(mShape == Cylinder)
+   {
+      Point3F base = getPosition();
+      Point3F tip = base + Point3F(0.0f, 0.0f, scale.z);
+      drawer->drawCylinder(desc, base, tip, getMax(scale.x, scale.y) * 0.5f, colour);
+   }
+   else
+   {
+      MatrixF mat = getRenderTransform();
+      drawer->drawCube(desc, scale, getWorldBox().getCenter(), colour, &mat);
+   }
+}
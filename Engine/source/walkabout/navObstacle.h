@@ -0,0 +1,116 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2014 Daniel Buckmaster
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef _NAVOBSTACLE_H_
+#define _NAVOBSTACLE_H_
+
+#ifndef _SCENEOBJECT_H_
+#include "scene/sceneObject.h"
+#endif
+
+#include <Recast.h>
+
+class BaseMatInstance;
+
+/// @class NavObstacle
+/// A box or cylinder that carves a hole in any NavMesh it overlaps. Unlike
+/// level geometry, obstacles can be added, moved and removed at runtime
+/// without rebuilding tiles from scratch.
+/// @see NavMesh
+class NavObstacle : public SceneObject
+{
+   typedef SceneObject Parent;
+
+   /// Network mask bits.
+   enum MaskBits
+   {
+      TransformMask = Parent::NextFreeMask << 0,
+      NextFreeMask  = Parent::NextFreeMask << 1
+   };
+
+public:
+   NavObstacle();
+   virtual ~NavObstacle();
+
+   DECLARE_CONOBJECT(NavObstacle);
+
+   /// Shape of the area carved out of the NavMesh.
+   enum Shape {
+      Box,
+      Cylinder
+   };
+
+   Shape getShape() const { return mShape; }
+
+   /// Mark the area covered by this obstacle as impassable.
+   /// @param ctx    Recast context to use.
+   /// @param radius Distance to expand the obstacle by, usually the radius
+   ///               of the characters using the heightfield.
+   /// @param height Height of the characters using the heightfield, so
+   ///               that spans they would stand on under us are also marked.
+   /// @param chf    Heightfield to mark.
+   void carve(rcContext *ctx, F32 radius, F32 height, rcCompactHeightfield &chf) const;
+
+   /// Return the server-side NavObstacle SimSet.
+   static SimSet *getServerSet();
+
+   /// @name SceneObject
+   /// @{
+   static void initPersistFields();
+
+   bool onAdd();
+   void onRemove();
+
+   void onEditorEnable();
+   void onEditorDisable();
+   void inspectPostApply();
+
+   void setTransform(const MatrixF &mat);
+   void setScale(const VectorF &scale);
+
+   void prepRenderImage(SceneRenderState *state);
+   void render(ObjectRenderInst *ri, SceneRenderState *state, BaseMatInstance *overrideMat);
+   /// @}
+
+   /// @name NetObject
+   /// @{
+   U32 packUpdate(NetConnection *conn, U32 mask, BitStream *stream);
+   void unpackUpdate(NetConnection *conn, BitStream *stream);
+   /// @}
+
+private:
+   /// Shape of this obstacle.
+   Shape mShape;
+
+   /// Tell NavMeshes that the area we cover has changed.
+   /// @param box   World box to update.
+   /// @param added Are we adding to the area (true) or removing it (false)?
+   void notifyMeshes(const Box3F &box, bool added);
+
+   /// Server-side set for all NavObstacle objects.
+   static SimObjectPtr<SimSet> smServerSet;
+};
+
+typedef NavObstacle::Shape NavObstacleShape;
+DefineEnumType(NavObstacleShape);
+
+#endif
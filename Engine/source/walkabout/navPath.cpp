@@ -42,6 +42,64 @@ extern bool gEditingMission;
 
 IMPLEMENT_CO_NETOBJECT_V1(NavPath);
 
+/// Bits used to send node indices and counts.
+static const U32 NetIndexBits = 16;
+/// Most nodes we will send to clients.
+static const U32 MaxNetPoints = (1 << NetIndexBits) - 1;
+/// Bits per axis of a quantised node position.
+static const U32 NetPointBits = 16;
+static const S32 NetPointSteps = (1 << NetPointBits) - 1;
+
+/// Find the NavMesh polygon under a point and drop the point onto it.
+/// @param query   Query to search with.
+/// @param filter  Polygons we are allowed to stand on.
+/// @param extents Half-size of the search box around the point.
+/// @param p       Point to snap, in Torque coordinates.
+/// @param ref     Set to the polygon we landed on.
+/// @return True if there was a polygon close enough.
+static bool snapToMesh(const dtNavMeshQuery *query, const dtQueryFilter &filter, const F32 *extents, Point3F &p, dtPolyRef &ref)
+{
+   // Search from a little above the point to twice the box height below it,
+   // so points placed in the air still find the ground they're over.
+   F32 pos[] = {p.x, p.z - extents[1] * 0.5f, -p.y};
+   F32 ext[] = {extents[0], extents[1] * 1.5f, extents[2]};
+   F32 nearest[3];
+   ref = 0;
+   if(dtStatusFailed(query->findNearestPoly(pos, ext, &filter, &ref, nearest)) || !ref)
+      return false;
+
+   // Keep our position if we're over the polygon, otherwise move onto it.
+   F32 height;
+   if(dtStatusSucceed(query->getPolyHeight(ref, pos, &height)))
+      p.z = height;
+   else
+      p = RCtoDTS(nearest);
+   return true;
+}
+
+/// Quantise a position to a grid over a box.
+static void quantisePoint(const Point3F &p, const Box3F &frame, S32 q[3])
+{
+   const Point3F ext = frame.getExtents();
+   for(U32 i = 0; i < 3; i++)
+   {
+      if(ext[i] > 0.0f)
+         q[i] = mClamp(S32(mFloor((p[i] - frame.minExtents[i]) / ext[i] * NetPointSteps + 0.5f)), 0, NetPointSteps);
+      else
+         q[i] = 0;
+   }
+}
+
+/// Recover a position quantised by quantisePoint.
+static Point3F dequantisePoint(const S32 q[3], const Box3F &frame)
+{
+   const Point3F ext = frame.getExtents();
+   Point3F p;
+   for(U32 i = 0; i < 3; i++)
+      p[i] = frame.minExtents[i] + ext[i] * q[i] / NetPointSteps;
+   return p;
+}
+
 NavPath::NavPath() :
    mFrom(0.0f, 0.0f, 0.0f),
    mTo(0.0f, 0.0f, 0.0f)
@@ -61,8 +119,22 @@ NavPath::NavPath() :
    mIsLooping = false;
    mAutoUpdate = false;
    mIsSliced = false;
+   mIsThreaded = false;
+   mJobPending = false;
+   mJobSerial = 0;
 
    mMaxIterations = 1;
+   mPriority = 0;
+   mIterationsDone = 0;
+   mStartRef = mEndRef = 0;
+   mCorridorCached = false;
+   mRouteStep = 0;
+   mPartial = false;
+   mPartialSent = false;
+   mCompletePoints = 0;
+   mCompleteLength = 0.0f;
+   mSentAppend = false;
+   mPathSerial = 0;
 
    mAlwaysRender = false;
    mXray = false;
@@ -73,8 +145,23 @@ NavPath::NavPath() :
 
 NavPath::~NavPath()
 {
-   dtFreeNavMeshQuery(mQuery);
+   releaseQuery();
+}
+
+void NavPath::releaseQuery()
+{
+   if(!mQuery)
+      return;
+   // Our mesh may have been deleted while we were planning.
+   if(mQueryMesh)
+   {
+      mQueryMesh->dequeuePath(this);
+      mQueryMesh->releaseQuery(mQuery);
+   }
+   else
+      dtFreeNavMeshQuery(mQuery);
    mQuery = NULL;
+   mQueryMesh = NULL;
 }
 
 void NavPath::checkAutoUpdate()
@@ -206,8 +293,13 @@ void NavPath::initPersistFields()
       "Does this path loop?");
    addField("isSliced", TypeBool, Offset(mIsSliced, NavPath),
       "Plan this path over multiple updates instead of all at once.");
+   addField("isThreaded", TypeBool, Offset(mIsThreaded, NavPath),
+      "Plan this path on a worker thread. Takes precedence over isSliced.");
    addFieldV("maxIterations", TypeS32, Offset(mMaxIterations, NavPath), &ValidIterations,
       "Maximum iterations of path planning this path does per tick.");
+   addField("priority", TypeS32, Offset(mPriority, NavPath),
+      "Sliced paths with higher priority are planned first when the NavMesh's "
+      "pathBudget is limited.");
    addProtectedField("autoUpdate", TypeBool, Offset(mAutoUpdate, NavPath),
       &setProtectedAutoUpdate, &defaultProtectedGetFn,
       "If set, this path will automatically replan when its navigation mesh changes.");
@@ -261,9 +353,6 @@ bool NavPath::onAdd()
 
    if(isServerObject())
    {
-      mQuery = dtAllocNavMeshQuery();
-      if(!mQuery)
-         return false;
       checkAutoUpdate();
       if(!plan())
          setProcessTick(true);
@@ -274,6 +363,8 @@ bool NavPath::onAdd()
 
 void NavPath::onRemove()
 {
+   releaseQuery();
+
    Parent::onRemove();
 
    removeFromScene();
@@ -283,23 +374,42 @@ bool NavPath::init()
 {
    mStatus = DT_FAILURE;
 
+   // Forget any threaded plan that's still running.
+   mJobSerial++;
+   mJobPending = false;
+
    // Check that all the right data is provided.
    if(!mMesh || !mMesh->getNavMesh())
       return false;
    if(!(mFromSet && mToSet) && !(mWaypoints && mWaypoints->size()))
       return false;
 
-   // Initialise our query.
-   if(dtStatusFailed(mQuery->init(mMesh->getNavMesh(), MaxPathLen)))
-      return false;
+   // Lease a query for as long as we're planning.
+   if(mQuery && mQueryMesh != mMesh)
+      releaseQuery();
+   if(!mQuery)
+   {
+      mQuery = mMesh->acquireQuery();
+      if(!mQuery)
+         return false;
+      mQueryMesh = mMesh;
+   }
 
    mPoints.clear();
    mFlags.clear();
    mVisitPoints.clear();
+   mCorridor.clear();
+   mRouteRefs.clear();
+   mRoutePoints.clear();
    mLength = 0.0f;
+   mPartial = false;
+   mPartialSent = false;
+   mCompletePoints = 0;
+   mCompleteLength = 0.0f;
+   mSentAppend = false;
+   mPathSerial++;
 
-   if(isServerObject())
-      setMaskBits(PathMask);
+   markPathDirty();
 
    // Add points we need to visit in reverse order.
    if(mWaypoints && mWaypoints->size())
@@ -375,7 +485,9 @@ bool NavPath::plan()
    if(!init())
       return false;
 
-   if(mIsSliced)
+   if(mIsThreaded)
+      return planThreaded();
+   else if(mIsSliced)
       return planSliced();
    else
       return planInstant();
@@ -385,12 +497,126 @@ bool NavPath::planSliced()
 {
    bool visited = visitNext();
 
+   // Our mesh updates us within its per-tick budget.
    if(visited)
-      setProcessTick(true);
+      mMesh->queuePath(this);
+   else
+      releaseQuery();
 
    return visited;
 }
 
+bool NavPath::planThreaded()
+{
+   NavPathJob *job = new NavPathJob();
+   ThreadSafeRef<NavPathJob> jobRef(job);
+   job->path = this;
+   job->serial = mJobSerial;
+   job->filter = mFilter;
+   job->extents[0] = mMesh->mWalkableRadius * 4.0f;
+   job->extents[1] = mMesh->mWalkableHeight;
+   job->extents[2] = mMesh->mWalkableRadius * 4.0f;
+
+   // The job has our query until it's done.
+   job->query = mQuery;
+   mQuery = NULL;
+   mQueryMesh = NULL;
+
+   job->visitPoints = mVisitPoints;
+
+   mJobPending = true;
+   mStatus = DT_IN_PROGRESS;
+   mMesh->queuePathJob(job);
+
+   return true;
+}
+
+bool NavPath::completeJob(NavPathJob *job)
+{
+   // We've been replanned since this job started.
+   if(job->serial != mJobSerial || !mJobPending)
+      return false;
+   mJobPending = false;
+
+   if(job->badPoint >= 0)
+   {
+      const Point3F &p = job->visitPoints[job->badPoint];
+      Con::errorf("No NavMesh polygon near visit point (%g, %g, %g) of NavPath %s",
+         p.x, p.y, p.z, getIdString());
+   }
+
+   mPoints = job->points;
+   mFlags = job->flags;
+   mCorridor = job->corridor;
+   mLength = job->length;
+   mStatus = job->status;
+   mPathSerial++;
+   markPathDirty();
+
+   finalise();
+   return true;
+}
+
+void NavPathJob::run()
+{
+   status = DT_SUCCESS;
+   for(S32 leg = visitPoints.size() - 1; leg > 0; leg--)
+   {
+      Point3F &start = visitPoints[leg];
+      Point3F &end = visitPoints[leg-1];
+
+      dtPolyRef startRef, endRef;
+      if(!snapToMesh(query, filter, extents, start, startRef))
+      {
+         badPoint = leg;
+         status = DT_FAILURE;
+         break;
+      }
+      if(!snapToMesh(query, filter, extents, end, endRef))
+      {
+         badPoint = leg - 1;
+         status = DT_FAILURE;
+         break;
+      }
+
+      F32 from[] = {start.x, start.z, -start.y};
+      F32 to[] =   {end.x,   end.z,   -end.y};
+
+      dtPolyRef path[NavPath::MaxPathLen];
+      S32 pathLen = 0;
+      status = query->findPath(startRef, endRef, from, to, &filter, path, &pathLen, NavPath::MaxPathLen);
+      if(dtStatusFailed(status) || !pathLen)
+      {
+         status = DT_FAILURE;
+         break;
+      }
+
+      corridor.setSize(pathLen);
+      dMemcpy(corridor.address(), path, pathLen * sizeof(dtPolyRef));
+
+      F32 straightPath[NavPath::MaxPathLen * 3];
+      S32 straightPathLen = 0;
+      dtPolyRef straightPathPolys[NavPath::MaxPathLen];
+      U8 straightPathFlags[NavPath::MaxPathLen];
+      query->findStraightPath(from, to, path, pathLen,
+         straightPath, straightPathFlags,
+         straightPathPolys, &straightPathLen, NavPath::MaxPathLen);
+
+      for(U32 i = 0; i < straightPathLen; i++)
+      {
+         Point3F p = RCtoDTS(straightPath + i * 3);
+         U16 f = 0;
+         mesh->getPolyFlags(straightPathPolys[i], &f);
+         if(points.size())
+            length += (p - points.last()).len();
+         points.push_back(p);
+         flags.push_back(f);
+      }
+   }
+
+   dCompareAndSwap(done, 0, 1);
+}
+
 bool NavPath::planInstant()
 {
    setProcessTick(false);
@@ -412,85 +638,200 @@ bool NavPath::visitNext()
    Point3F &start = mVisitPoints[s-1];
    Point3F &end = mVisitPoints[s-2];
 
-   // Drop to height of statics.
-   RayInfo info;
-   if(getContainer()->castRay(start, start - Point3F(0, 0, mMesh->mWalkableHeight * 2.0f), StaticObjectType, &info))
-      start = info.point;
-   if(getContainer()->castRay(end + Point3F(0, 0, 0.1f), end - Point3F(0, 0, mMesh->mWalkableHeight * 2.0f), StaticObjectType, &info))
-      end = info.point;
-
-   // Convert to Detour-friendly coordinates and data structures.
-   F32 from[] = {start.x, start.z, -start.y};
-   F32 to[] =   {end.x,   end.z,   -end.y};
+   // Drop both ends onto the NavMesh.
    F32 extx = mMesh->mWalkableRadius * 4.0f;
    F32 extz = mMesh->mWalkableHeight;
    F32 extents[] = {extx, extz, extx};
    dtPolyRef startRef, endRef;
 
-   if(dtStatusFailed(mQuery->findNearestPoly(from, extents, &mFilter, &startRef, NULL)) || !startRef)
+   if(!snapToMesh(mQuery, mFilter, extents, start, startRef))
    {
       Con::errorf("No NavMesh polygon near visit point (%g, %g, %g) of NavPath %s",
          start.x, start.y, start.z, getIdString());
       return false;
    }
 
-   if(dtStatusFailed(mQuery->findNearestPoly(to, extents, &mFilter, &endRef, NULL)) || !endRef)
+   if(!snapToMesh(mQuery, mFilter, extents, end, endRef))
    {
       Con::errorf("No NavMesh polygon near visit point (%g, %g, %g) of NavPath %s",
          end.x, end.y, end.z, getIdString());
       return false;
    }
 
+   // Convert to Detour-friendly coordinates and data structures.
+   F32 from[] = {start.x, start.z, -start.y};
+   F32 to[] =   {end.x,   end.z,   -end.y};
+
+   mStartRef = startRef;
+   mEndRef = endRef;
+
+   // A search would only fail after visiting everything it could reach.
+   if(!mMesh->canReach(startRef, endRef, mFilter))
+   {
+      mStatus = DT_FAILURE;
+      return false;
+   }
+
+   // Skip the search if we already know the way.
+   mRouteRefs.clear();
+   mRoutePoints.clear();
+   const Vector<dtPolyRef> *corridor = mMesh->findCorridor(startRef, endRef, mFilter);
+   mCorridorCached = corridor != NULL;
+   if(mCorridorCached)
+   {
+      mCorridor = *corridor;
+      mStatus = DT_SUCCESS;
+      return true;
+   }
+
+   mQuery->setHeuristic(mMesh->getHeuristic());
+
+   // A single search would run out of nodes on long legs, so plan a route
+   // between tile borders first and search along it one part at a time.
+   mCorridor.clear();
+   if(mMesh->findHierarchicalRoute(startRef, endRef, from, to, mFilter, mRouteRefs, mRoutePoints))
+   {
+      mRouteStep = 0;
+      if(searchRouteStep())
+         return true;
+   }
+
+   return searchLeg();
+}
+
+bool NavPath::searchLeg()
+{
+   U32 s = mVisitPoints.size();
+   Point3F start = mVisitPoints[s-1];
+   Point3F end = mVisitPoints[s-2];
+   F32 from[] = {start.x, start.z, -start.y};
+   F32 to[] =   {end.x,   end.z,   -end.y};
+
+   mRouteRefs.clear();
+   mRoutePoints.clear();
+   mCorridor.clear();
+
    // Init sliced pathfind.
-   mStatus = mQuery->initSlicedFindPath(startRef, endRef, from, to, &mFilter);
+   mStatus = mQuery->initSlicedFindPath(mStartRef, mEndRef, from, to, &mFilter);
    if(dtStatusFailed(mStatus))
       return false;
 
    return true;
 }
 
+bool NavPath::searchRouteStep()
+{
+   U32 s = mVisitPoints.size();
+   Point3F start = mVisitPoints[s-1];
+   F32 from[] = {start.x, start.z, -start.y};
+
+   // Each part starts where the last one ended.
+   dtPolyRef startRef = mStartRef;
+   const F32 *stepFrom = from;
+   if(mRouteStep > 0)
+   {
+      startRef = mRouteRefs[mRouteStep-1];
+      stepFrom = mRoutePoints[mRouteStep-1];
+   }
+
+   mStatus = mQuery->initSlicedFindPath(startRef, mRouteRefs[mRouteStep],
+      stepFrom, mRoutePoints[mRouteStep], &mFilter);
+   if(dtStatusFailed(mStatus))
+      return false;
+
+   return true;
+}
+
+bool NavPath::step(S32 &iterations)
+{
+   S32 store = mMaxIterations;
+   mMaxIterations = getMax(iterations, 1);
+   mIterationsDone = 0;
+   bool more = update();
+   mMaxIterations = store;
+   // Give whoever is waiting for us somewhere to start heading.
+   if(more && !mPartialSent && dtStatusInProgress(mStatus) && addPartialPoints())
+   {
+      mPartialSent = true;
+      resize();
+      mPartialSignal.trigger(this);
+   }
+   iterations = mIterationsDone;
+   return more;
+}
+
 bool NavPath::update()
 {
    if(dtStatusInProgress(mStatus))
-      mStatus = mQuery->updateSlicedFindPath(mMaxIterations, NULL);
+   {
+      int done = 0;
+      mStatus = mQuery->updateSlicedFindPath(mMaxIterations, &done);
+      mIterationsDone += done;
+   }
+   if(dtStatusSucceed(mStatus) && mRouteRefs.size())
+   {
+      // Add this part of a hierarchical route to the leg's corridor.
+      dtPolyRef path[MaxPathLen];
+      S32 pathLen = 0;
+      mStatus = mQuery->finalizeSlicedFindPath(path, &pathLen, MaxPathLen);
+      if(dtStatusFailed(mStatus) || dtStatusDetail(mStatus, DT_PARTIAL_RESULT) ||
+         !pathLen || path[pathLen-1] != mRouteRefs[mRouteStep])
+      {
+         // The route can't be followed, so fall back to searching the
+         // whole leg.
+         return searchLeg();
+      }
+      for(S32 i = mCorridor.size() && mCorridor.last() == path[0] ? 1 : 0; i < pathLen; i++)
+         mCorridor.push_back(path[i]);
+      mRouteStep++;
+      if(mRouteStep < mRouteRefs.size())
+         return searchRouteStep() || searchLeg();
+
+      // The whole leg is refined.
+      mRouteRefs.clear();
+      mRoutePoints.clear();
+      mMesh->cacheCorridor(mStartRef, mEndRef, mFilter, mCorridor.address(), mCorridor.size());
+      mCorridorCached = true;
+   }
    if(dtStatusSucceed(mStatus))
    {
       // Add points from this leg.
       dtPolyRef path[MaxPathLen];
-      S32 pathLen;
-      mStatus = mQuery->finalizeSlicedFindPath(path, &pathLen, MaxPathLen);
+      const dtPolyRef *corridor = path;
+      S32 pathLen = 0;
+      if(mCorridorCached)
+      {
+         corridor = mCorridor.address();
+         pathLen = mCorridor.size();
+      }
+      else
+      {
+         mStatus = mQuery->finalizeSlicedFindPath(path, &pathLen, MaxPathLen);
+         // Partial corridors aren't worth reusing.
+         if(dtStatusSucceed(mStatus) && !dtStatusDetail(mStatus, DT_PARTIAL_RESULT) && pathLen)
+            mMesh->cacheCorridor(mStartRef, mEndRef, mFilter, path, pathLen);
+         if(dtStatusSucceed(mStatus))
+         {
+            mCorridor.setSize(pathLen);
+            dMemcpy(mCorridor.address(), path, pathLen * sizeof(dtPolyRef));
+         }
+      }
       if(dtStatusSucceed(mStatus) && pathLen)
       {
-         F32 straightPath[MaxPathLen * 3];
-         S32 straightPathLen;
-         dtPolyRef straightPathPolys[MaxPathLen];
-         U8 straightPathFlags[MaxPathLen];
-
          U32 s = mVisitPoints.size();
          Point3F start = mVisitPoints[s-1];
          Point3F end = mVisitPoints[s-2];
          F32 from[] = {start.x, start.z, -start.y};
          F32 to[] =   {end.x,   end.z,   -end.y};
 
-         mQuery->findStraightPath(from, to, path, pathLen,
-            straightPath, straightPathFlags,
-            straightPathPolys, &straightPathLen, MaxPathLen);
-
-         s = mPoints.size();
-         mPoints.increment(straightPathLen);
-         mFlags.increment(straightPathLen);
-         for(U32 i = 0; i < straightPathLen; i++)
-         {
-            F32 *f = straightPath + i * 3;
-            mPoints[s + i] = RCtoDTS(f);
-            mMesh->getNavMesh()->getPolyFlags(straightPathPolys[i], &mFlags[s + i]);
-            // Add to length
-            if(s > 0 || i > 0)
-               mLength += (mPoints[s+i] - mPoints[s+i-1]).len();
-         }
-
-         if(isServerObject())
-            setMaskBits(PathMask);
+         // This leg replaces any partial result we gave out.
+         mPoints.setSize(mCompletePoints);
+         mFlags.setSize(mCompletePoints);
+         mLength = mCompleteLength;
+         mPartial = false;
+         addCorridorPoints(from, to, corridor, pathLen);
+         mCompletePoints = mPoints.size();
+         mCompleteLength = mLength;
       }
       else
          return false;
@@ -515,10 +856,103 @@ bool NavPath::update()
    return true;
 }
 
+void NavPath::addCorridorPoints(const F32 *from, const F32 *to, const dtPolyRef *corridor, S32 pathLen)
+{
+   F32 straightPath[MaxPathLen * 3];
+   S32 straightPathLen;
+   dtPolyRef straightPathPolys[MaxPathLen];
+   U8 straightPathFlags[MaxPathLen];
+
+   mQuery->findStraightPath(from, to, corridor, pathLen,
+      straightPath, straightPathFlags,
+      straightPathPolys, &straightPathLen, MaxPathLen);
+
+   U32 s = mPoints.size();
+   mPoints.increment(straightPathLen);
+   mFlags.increment(straightPathLen);
+   for(U32 i = 0; i < straightPathLen; i++)
+   {
+      F32 *f = straightPath + i * 3;
+      mPoints[s + i] = RCtoDTS(f);
+      mMesh->getNavMesh()->getPolyFlags(straightPathPolys[i], &mFlags[s + i]);
+      // Add to length
+      if(s > 0 || i > 0)
+         mLength += (mPoints[s+i] - mPoints[s+i-1]).len();
+   }
+
+   markPathDirty(s);
+}
+
+bool NavPath::addPartialPoints()
+{
+   dtPolyRef path[MaxPathLen];
+   S32 pathLen = 0;
+   // Hierarchical legs carry on from the parts of their route already found.
+   S32 prefix = 0;
+   if(mRouteRefs.size())
+   {
+      prefix = getMin((S32)mCorridor.size(), (S32)MaxPathLen - 1);
+      dMemcpy(path, mCorridor.address(), prefix * sizeof(dtPolyRef));
+   }
+   if(dtStatusFailed(mQuery->getSlicedFindPathPartial(path + prefix, &pathLen, MaxPathLen - prefix)))
+      return false;
+   if(prefix && pathLen && path[prefix] == path[prefix-1])
+   {
+      dMemmove(path + prefix, path + prefix + 1, (pathLen - 1) * sizeof(dtPolyRef));
+      pathLen--;
+   }
+   pathLen += prefix;
+   if(!pathLen)
+      return false;
+
+   U32 s = mVisitPoints.size();
+   Point3F start = mVisitPoints[s-1];
+   Point3F end = mVisitPoints[s-2];
+   F32 from[] = {start.x, start.z, -start.y};
+   F32 to[] =   {end.x,   end.z,   -end.y};
+
+   // Head for the point on the best polygon so far that's nearest the goal.
+   F32 nearest[3];
+   if(dtStatusFailed(mQuery->closestPointOnPoly(path[pathLen-1], to, nearest)))
+      return false;
+
+   mPoints.setSize(mCompletePoints);
+   mFlags.setSize(mCompletePoints);
+   mLength = mCompleteLength;
+   addCorridorPoints(from, nearest, path, pathLen);
+   mPartial = true;
+   return true;
+}
+
+void NavPath::abort()
+{
+   mStatus = DT_FAILURE;
+   finalise();
+}
+
 bool NavPath::finalise()
 {
    setProcessTick(false);
 
+   // A partial result is no use once planning has stopped.
+   if(mPartial)
+   {
+      mPoints.setSize(mCompletePoints);
+      mFlags.setSize(mCompletePoints);
+      mLength = mCompleteLength;
+      mPartial = false;
+      markPathDirty(mCompletePoints);
+   }
+
+   // Clients that lost one of our appends can't fill the gap themselves.
+   if(mSentAppend)
+   {
+      mSentAppend = false;
+      markPathDirty();
+   }
+
+   releaseQuery();
+
    resize();
 
    return success();
@@ -529,8 +963,6 @@ void NavPath::processTick(const Move *move)
    if(!mMesh)
       if(Sim::findObject(mMeshName.c_str(), mMesh))
          plan();
-   if(dtStatusInProgress(mStatus))
-      update();
 }
 
 Point3F NavPath::getNode(S32 idx) const
@@ -552,6 +984,43 @@ S32 NavPath::size() const
    return mPoints.size();
 }
 
+void NavPath::markPathDirty(U32 from)
+{
+   if(!isServerObject() || !isProperlyAdded())
+      return;
+   if(from == 0)
+      setMaskBits(PathMask);
+   else
+   {
+      for(U32 i = 0; i < mSendFrom.size();)
+      {
+         // Forget connections that have gone away.
+         if(mSendFrom[i].conn.isNull())
+         {
+            mSendFrom.erase_fast(i);
+            continue;
+         }
+         mSendFrom[i].from = getMin(mSendFrom[i].from, from);
+         i++;
+      }
+      mSentAppend = true;
+      setMaskBits(AppendMask);
+   }
+}
+
+NavPath::NetSendFrom &NavPath::getSendFrom(NetConnection *conn)
+{
+   for(U32 i = 0; i < mSendFrom.size(); i++)
+      if(mSendFrom[i].conn == conn)
+         return mSendFrom[i];
+   mSendFrom.increment();
+   NetSendFrom &s = mSendFrom.last();
+   s.conn = conn;
+   // New connections get the whole path in their first update.
+   s.from = 0;
+   return s;
+}
+
 void NavPath::onEditorEnable()
 {
    mNetFlags.set(Ghostable);
@@ -655,14 +1124,18 @@ U32 NavPath::packUpdate(NetConnection *conn, U32 mask, BitStream *stream)
    if(stream->writeFlag(mToSet))
       mathWrite(*stream, mTo);
 
-   if(stream->writeFlag(mask & PathMask))
+   if(stream->writeFlag(mask & (PathMask | AppendMask)))
    {
-      stream->writeInt(mPoints.size(), 32);
-      for(U32 i = 0; i < mPoints.size(); i++)
-      {
-         mathWrite(*stream, mPoints[i]);
-         stream->writeInt(mFlags[i], 16);
-      }
+      // Unless the whole path was replaced, only send what changed since
+      // this connection's last update.
+      NetSendFrom &sendFrom = getSendFrom(conn);
+      const U32 count = getMin(mPoints.size(), (U32)MaxNetPoints);
+      const U32 from = (mask & PathMask) ? 0 : getMin(sendFrom.from, count);
+      sendFrom.from = count;
+      stream->writeInt(mPathSerial, 8);
+      stream->writeInt(from, NetIndexBits);
+      stream->writeInt(count - from, NetIndexBits);
+      writePoints(stream, from, count);
    }
 
    return retMask;
@@ -684,18 +1157,99 @@ void NavPath::unpackUpdate(NetConnection *conn, BitStream *stream)
 
    if(stream->readFlag())
    {
-      mPoints.clear();
-      mFlags.clear();
-      mPoints.setSize(stream->readInt(32));
-      mFlags.setSize(mPoints.size());
-      for(U32 i = 0; i < mPoints.size(); i++)
+      const U8 serial = stream->readInt(8);
+      const U32 from = stream->readInt(NetIndexBits);
+      const U32 count = stream->readInt(NetIndexBits);
+      Vector<Point3F> points;
+      Vector<U16> flags;
+      readPoints(stream, count, points, flags);
+
+      // Appends are only any use if we have everything before them.
+      if(from == 0 || (serial == mPathSerial && from <= mPoints.size()))
       {
-         Point3F p;
-         mathRead(*stream, &p);
-         mPoints[i] = p;
-         mFlags[i] = stream->readInt(16);
+         mPathSerial = serial;
+         mPoints.setSize(from);
+         mFlags.setSize(from);
+         mPoints.merge(points);
+         mFlags.merge(flags);
+         resize();
       }
-      resize();
+   }
+}
+
+void NavPath::writePoints(BitStream *stream, U32 from, U32 to)
+{
+   if(from >= to)
+      return;
+
+   // Quantise relative to our NavMesh, stretched to fit any nodes that lie
+   // just outside it.
+   Box3F frame = mMesh ? mMesh->getWorldBox() : Box3F(mPoints[from], mPoints[from]);
+   for(U32 i = from; i < to; i++)
+      frame.extend(mPoints[i]);
+   mathWrite(*stream, frame);
+
+   // All deltas are written with the same width, wide enough for the
+   // biggest jump between consecutive nodes.
+   S32 prev[3], q[3];
+   S32 biggest = 1;
+   quantisePoint(mPoints[from], frame, prev);
+   for(U32 i = from + 1; i < to; i++)
+   {
+      quantisePoint(mPoints[i], frame, q);
+      for(U32 j = 0; j < 3; j++)
+      {
+         biggest = getMax(biggest, mAbs(q[j] - prev[j]));
+         prev[j] = q[j];
+      }
+   }
+   S32 bits = 1;
+   while(biggest >> bits)
+      bits++;
+   // One more for the sign.
+   bits++;
+   stream->writeInt(bits, 5);
+
+   quantisePoint(mPoints[from], frame, prev);
+   for(U32 j = 0; j < 3; j++)
+      stream->writeInt(prev[j], NetPointBits);
+   stream->writeInt(mFlags[from], 16);
+   for(U32 i = from + 1; i < to; i++)
+   {
+      quantisePoint(mPoints[i], frame, q);
+      for(U32 j = 0; j < 3; j++)
+      {
+         stream->writeSignedInt(q[j] - prev[j], bits);
+         prev[j] = q[j];
+      }
+      // Most nodes share their neighbour's flags.
+      if(!stream->writeFlag(mFlags[i] == mFlags[i-1]))
+         stream->writeInt(mFlags[i], 16);
+   }
+}
+
+void NavPath::readPoints(BitStream *stream, U32 count, Vector<Point3F> &points, Vector<U16> &flags)
+{
+   points.setSize(count);
+   flags.setSize(count);
+   if(!count)
+      return;
+
+   Box3F frame;
+   mathRead(*stream, &frame);
+   const S32 bits = stream->readInt(5);
+
+   S32 q[3];
+   for(U32 j = 0; j < 3; j++)
+      q[j] = stream->readInt(NetPointBits);
+   points[0] = dequantisePoint(q, frame);
+   flags[0] = stream->readInt(16);
+   for(U32 i = 1; i < count; i++)
+   {
+      for(U32 j = 0; j < 3; j++)
+         q[j] += stream->readSignedInt(bits);
+      points[i] = dequantisePoint(q, frame);
+      flags[i] = stream->readFlag() ? flags[i-1] : stream->readInt(16);
    }
 }
 
@@ -712,8 +1266,9 @@ DefineEngineMethod(NavPath, onNavMeshUpdate, void, (const char *data),,
       object->plan();
 }
 
-DefineEngineMethod(NavPath, onNavMeshUpdateBox, void, (const char *data),,
-   "@brief Callback when a particular area in this path's NavMesh is rebuilt.")
+/// Replan a path if the area described by an event's "meshId box" data
+/// overlaps it.
+static void replanInBox(NavPath *object, const char *data)
 {
    String s(data);
    U32 space = s.find(' ');
@@ -730,6 +1285,24 @@ DefineEngineMethod(NavPath, onNavMeshUpdateBox, void, (const char *data),,
    }
 }
 
+DefineEngineMethod(NavPath, onNavMeshUpdateBox, void, (const char *data),,
+   "@brief Callback when a particular area in this path's NavMesh is rebuilt.")
+{
+   replanInBox(object, data);
+}
+
+DefineEngineMethod(NavPath, onNavMeshObstacleAdded, void, (const char *data),,
+   "@brief Callback when an obstacle is added to an area of this path's NavMesh.")
+{
+   replanInBox(object, data);
+}
+
+DefineEngineMethod(NavPath, onNavMeshObstacleRemoved, void, (const char *data),,
+   "@brief Callback when an obstacle is removed from an area of this path's NavMesh.")
+{
+   replanInBox(object, data);
+}
+
 DefineEngineMethod(NavPath, size, S32, (),,
    "@brief Return the number of nodes in this path.")
 {
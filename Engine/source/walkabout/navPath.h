@@ -26,10 +26,17 @@
 #include "scene/sceneObject.h"
 #include "scene/simPath.h"
 #include "navMesh.h"
+#include "core/util/tSignal.h"
+#include "platform/threads/threadSafeRefCount.h"
+#include "sim/netConnection.h"
 #include <DetourNavMeshQuery.h>
 
+struct NavPathJob;
+
 class NavPath: public SceneObject {
    typedef SceneObject Parent;
+   friend struct NavPathJob;
+   /// Maximum number of polygons in each leg of the path.
    static const U32 MaxPathLen = 2048;
 public:
    /// @name NavPath
@@ -48,9 +55,14 @@ public:
    bool mIsLooping;
    bool mAutoUpdate;
    bool mIsSliced;
+   /// Plan on a worker thread instead of in the simulation?
+   bool mIsThreaded;
 
    S32 mMaxIterations;
 
+   /// Sliced paths with higher priority are updated first by their NavMesh.
+   S32 mPriority;
+
    bool mAlwaysRender;
    bool mXray;
    bool mRenderSearch;
@@ -69,9 +81,41 @@ public:
    /// @return True if the plan was successful overall.
    bool finalise();
 
+   /// Stop a sliced plan and fail it, without triggering mPlannedSignal.
+   /// Called by our NavMesh before it frees the mesh we're searching.
+   void abort();
+
+   /// Advance a sliced plan, as scheduled by our NavMesh.
+   /// @param iterations Maximum search iterations to use; set to the number
+   ///                   actually used.
+   /// @return True if we need to keep updating, false if we can stop.
+   bool step(S32 &iterations);
+
    /// Did the path plan successfully?
    bool success() const { return dtStatusSucceed(mStatus); }
 
+   /// Are we in the middle of planning?
+   bool isPlanning() const { return mQuery != NULL || mJobPending; }
+
+   /// Take the results of a threaded plan. Called by our NavMesh, which
+   /// triggers mPlannedSignal afterwards, since a listener may delete us.
+   /// @return False if the job was stale and has been ignored.
+   bool completeJob(NavPathJob *job);
+
+   /// Signal triggered when a sliced or threaded plan finishes, with whether
+   /// it succeeded.
+   typedef Signal<void(NavPath*, bool)> PlannedSignal;
+   PlannedSignal mPlannedSignal;
+
+   /// Signal triggered once per sliced plan, after its first step, if the
+   /// plan isn't finished. Our nodes are then a path towards the best
+   /// polygon found so far, which is replaced when planning finishes.
+   typedef Signal<void(NavPath*)> PartialSignal;
+   PartialSignal mPartialSignal;
+
+   /// Are our nodes a partial result of a plan still in progress?
+   bool isPartial() const { return mPartial; }
+
    /// @}
 
    /// @name Path interface
@@ -92,6 +136,10 @@ public:
    /// Get the flags for a given path node.
    U16 getFlags(S32 idx) const;
 
+   /// Polygons the last leg of the path passes through, for characters
+   /// that steer along them instead of along our nodes.
+   const Vector<dtPolyRef> &getCorridor() const { return mCorridor; }
+
    /// @}
 
    /// @name SceneObject
@@ -129,7 +177,8 @@ public:
 protected:
    enum masks {
       PathMask     = Parent::NextFreeMask << 0,
-      NextFreeMask = Parent::NextFreeMask << 1
+      AppendMask   = Parent::NextFreeMask << 1,
+      NextFreeMask = Parent::NextFreeMask << 2
    };
 
 private:
@@ -143,14 +192,67 @@ private:
    /// @return True if the plan initialised successfully.
    bool planSliced();
 
+   /// Start planning on a worker thread.
+   /// @return True if the job was queued.
+   bool planThreaded();
+
+   /// Is a threaded plan running for us?
+   bool mJobPending;
+   /// Incremented for every threaded plan, so stale results are ignored.
+   U32 mJobSerial;
+
    /// Add points of the path between the two specified points.
    //bool addPoints(Point3F from, Point3F to, Vector<Point3F> *points);
 
+   /// Add the straightened points of a polygon corridor to our node list.
+   void addCorridorPoints(const F32 *from, const F32 *to, const dtPolyRef *corridor, S32 pathLen);
+
+   /// Replace any partial result with the path the current leg's search
+   /// has found so far.
+   /// @return True if there was a path to use.
+   bool addPartialPoints();
+
+   /// Are our last nodes a partial result?
+   bool mPartial;
+   /// Has this plan had a partial result yet?
+   bool mPartialSent;
+   /// Nodes and length from legs that have been completely planned.
+   U32 mCompletePoints;
+   F32 mCompleteLength;
+
    /// 'Visit' the last two points on our visit list.
    bool visitNext();
 
+   /// Start a sliced search over the whole of the current leg.
+   bool searchLeg();
+
+   /// Start a sliced search for the next part of the current leg's route.
+   bool searchRouteStep();
+
+   /// Query leased from a NavMesh while we are planning.
    dtNavMeshQuery *mQuery;
+   /// Mesh our query was leased from.
+   SimObjectPtr<NavMesh> mQueryMesh;
+   /// Give our query back to its NavMesh.
+   void releaseQuery();
+
    dtStatus mStatus;
+   /// Polygons at the ends of the current leg.
+   dtPolyRef mStartRef, mEndRef;
+   /// Was the current leg's corridor found in our NavMesh's cache, or
+   /// planned hierarchically, instead of by our own search?
+   bool mCorridorCached;
+   /// Polygons of the current leg, once they are known.
+   Vector<dtPolyRef> mCorridor;
+   /// Polygons and Recast-space positions a hierarchically planned leg
+   /// passes through. We search our way to each in turn, adding to
+   /// mCorridor as we go.
+   Vector<dtPolyRef> mRouteRefs;
+   Vector<Point3F> mRoutePoints;
+   /// Index in mRouteRefs of the polygon being searched for.
+   U32 mRouteStep;
+   /// Search iterations used since the last step.
+   S32 mIterationsDone;
    dtQueryFilter mFilter;
    S32 mCurIndex;
    Vector<Point3F> mPoints;
@@ -161,6 +263,34 @@ private:
    /// Resets our world transform and bounds to fit our point list.
    void resize();
 
+   /// Send our points to clients, if we're registered to be ghosted. Paths
+   /// that characters plan for themselves may never be registered.
+   /// @param from First node that changed. Anything after the start is sent
+   ///             as an append to the nodes clients already have.
+   void markPathDirty(U32 from = 0);
+
+   /// Lowest node index changed since our nodes were last written to a
+   /// connection. Kept for each one, so a connection that doesn't get an
+   /// update every step is still sent every node appended since its last.
+   struct NetSendFrom {
+      SimObjectPtr<NetConnection> conn;
+      U32 from;
+   };
+   Vector<NetSendFrom> mSendFrom;
+
+   /// Entry in mSendFrom for a connection, added if it has none.
+   NetSendFrom &getSendFrom(NetConnection *conn);
+   /// Have we sent clients only the end of this plan's nodes?
+   bool mSentAppend;
+   /// Changed whenever our nodes are replaced, so clients can tell whether
+   /// appended nodes continue the path they already have.
+   U8 mPathSerial;
+
+   /// Write nodes quantised to our NavMesh's bounds and delta-encoded.
+   void writePoints(BitStream *stream, U32 from, U32 to);
+   /// Read nodes written by writePoints.
+   static void readPoints(BitStream *stream, U32 count, Vector<Point3F> &points, Vector<U16> &flags);
+
    /// Function used to set mMesh object from console.
    static bool setProtectedMesh(void *obj, const char *index, const char *data);
 
@@ -180,4 +310,60 @@ private:
    /// @}
 };
 
+/// A path planned in full on a worker thread. The NavMesh it belongs to
+/// collects it on the main thread when it is done.
+struct NavPathJob : public ThreadSafeRefCount<NavPathJob>
+{
+   /// @name Main thread only
+   /// @{
+
+   /// Path to deliver the results to.
+   SimObjectPtr<NavPath> path;
+   /// Which of path's plans this job is for.
+   U32 serial;
+   /// Has this job been handed to the thread pool?
+   bool started;
+
+   /// @}
+
+   /// @name Input
+   /// @{
+
+   /// Keeps mesh alive while we read it.
+   ThreadSafeRef<NavMeshSnapshot> snapshot;
+   const dtNavMesh *mesh;
+   /// Leased from the NavMesh for the duration of the job.
+   dtNavMeshQuery *query;
+   dtQueryFilter filter;
+   /// Points to visit, in reverse order.
+   Vector<Point3F> visitPoints;
+   /// Search extents around each visit point, in Recast space.
+   F32 extents[3];
+
+   /// @}
+
+   /// @name Output
+   /// @{
+
+   Vector<Point3F> points;
+   Vector<U16> flags;
+   /// Polygons of the last leg.
+   Vector<dtPolyRef> corridor;
+   F32 length;
+   dtStatus status;
+   /// Index of a visit point with no nearby polygon, or -1.
+   S32 badPoint;
+
+   /// @}
+
+   /// Set by the worker thread when results are ready.
+   volatile U32 done;
+
+   NavPathJob() : serial(0), started(false), mesh(NULL), query(NULL),
+      length(0.0f), status(DT_FAILURE), badPoint(-1), done(0) {}
+
+   /// Plan the path. Called on a worker thread.
+   void run();
+};
+
 #endif
@@ -100,6 +100,7 @@ function NavEditorPlugin::onWorldEditorStartup(%this)
       EWCreatorWindow.registerMissionObject("NavMesh", "Navigation mesh");
       EWCreatorWindow.registerMissionObject("NavPath", "Path");
       EWCreatorWindow.registerMissionObject("CoverPoint", "Cover point");
+      EWCreatorWindow.registerMissionObject("NavObstacle", "Obstacle");
 
    EWCreatorWindow.endGroup();
 }